@@ -1,29 +1,57 @@
 #include <algorithm>
 #include <array>
 #include <barrier>
+#include <bitset>
+#include <bit>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <optional>
+#include <set>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <span>
 #include <sstream>
 #include <random>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <cerrno>
 #include <cstdint>
+#include <cstring>
+#include <cctype>
 #include <clocale>
 
+#include <fcntl.h>
 #include <ncurses.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <termios.h>
 #include <unistd.h>
+#include <zlib.h>
+
+#include <openssl/evp.h>
 
 #include <libs/src/rapidjson/include/rapidjson/document.h>
 #include <libs/src/rapidjson/include/rapidjson/filereadstream.h>
+#include <libs/src/rapidjson/include/rapidjson/reader.h>
 
 #define CPPHTTPLIB_OPENSSL_SUPPORT
+#define CPPHTTPLIB_ZLIB_SUPPORT
 #include <libs/src/cpp-httplib/httplib.h>
 
 #include <libs/src/rapidfuzz-cpp/rapidfuzz/fuzz.hpp>
@@ -42,12 +70,71 @@ enum chstate : unsigned int {
 struct chinfo_t {
     char ch;
     chstate state = chstate::original;
+    std::uint32_t word = 0; /* spaces belong to the word after them */
+};
+
+/* elements live in one vector with a hole at the last edit point, so inserting or erasing next to the caret */
+/* only moves the elements between the previous edit and this one instead of the whole tail */
+template <typename T>
+class GapBuffer {
+public:
+    GapBuffer() = default;
+
+    explicit GapBuffer(std::vector<T> init) : data(std::move(init)), gap_begin(data.size()), gap_end(data.size()) {}
+
+    [[nodiscard]] std::size_t size() const { return data.size() - (gap_end - gap_begin); }
+
+    T &operator[](std::size_t i) { return data[i < gap_begin ? i : i + (gap_end - gap_begin)]; }
+    const T &operator[](std::size_t i) const { return data[i < gap_begin ? i : i + (gap_end - gap_begin)]; }
+
+    void insert(std::size_t pos, const T &value) {
+        if (gap_begin == gap_end) { grow(); }
+        move_gap(pos);
+        data[gap_begin++] = value;
+    }
+
+    void erase(std::size_t pos) {
+        move_gap(pos);
+        gap_end++;
+    }
+
+private:
+    void move_gap(std::size_t pos) {
+        if (pos < gap_begin) {
+            std::move_backward(data.begin() + pos, data.begin() + gap_begin, data.begin() + gap_end);
+            gap_end -= gap_begin - pos;
+            gap_begin = pos;
+        } else if (pos > gap_begin) {
+            std::move(data.begin() + gap_end, data.begin() + gap_end + (pos - gap_begin), data.begin() + gap_begin);
+            gap_end += pos - gap_begin;
+            gap_begin = pos;
+        }
+    }
+
+    /* doubling keeps inserts amortized O(1) */
+    void grow() {
+        const std::size_t gap = std::max<std::size_t>(64, size());
+        std::vector<T> grown(data.size() + gap);
+        std::move(data.begin(), data.begin() + gap_begin, grown.begin());
+        std::move(data.begin() + gap_end, data.end(), grown.begin() + gap_begin + gap);
+        gap_end = gap_begin + gap;
+        data = std::move(grown);
+    }
+
+    std::vector<T> data;
+    std::size_t gap_begin = 0, gap_end = 0;
 };
 
+using TextBuffer = GapBuffer<chinfo_t>;
+
 bool has_color = false;
 
 const std::string CONFIG_FILENAME = "main.conf";
-const std::string LOG_FILENAME = "main.log";
+const std::string HISTORY_FILENAME = "history.bin";
+const std::string HISTORY_INDEX_FILENAME = "history.idx";
+const std::string KEYSTATS_FILENAME = "keystats.bin";
+const std::string THEME_CACHE_FILENAME = "themes/_themes.bin";
+const std::string CUSTOM_PROGRESS_FILENAME = "custom.progress";
 
 /* https://vi.stackexchange.com/questions/25151/how-to-change-vim-cursor-shape-in-text-console */
 /* but remember to invert output if animating 2nd half !! */
@@ -70,6 +157,8 @@ void ease(double t, double &ox, double &oy) {
 }
 
 
+static constexpr long double chars_per_word = 5.0;
+
 template <typename T>
 T coeff_variation(const std::vector<T> &samples) {
     
@@ -84,6 +173,71 @@ T coeff_variation(const std::vector<T> &samples) {
     return std::sqrt(std::accumulate(samples.begin(), samples.end(), 0.0, variance_func)) / mean;
 }
 
+struct TestResult {
+    long double wpm = 0.0, raw = 0.0, accuracy = 0.0, consistency = 0.0;
+};
+
+/* streaming statistics for every mode, see https://monkeytype.com/about */
+/* O(1) per keystroke and nothing kept per sample: one-second raw wpm buckets go straight into a welford accumulator */
+class LiveStats {
+public:
+    /* every typed char, backspace excluded */
+    void keystroke(bool correct, std::uint64_t now) {
+        if (start_ns == 0) { start_ns = now; }
+        roll(now);
+        keystrokes++;
+        correct_keystrokes += static_cast<std::uint64_t>(correct);
+        bucket_chars++;
+    }
+
+    /* closes every whole second up to now, idle seconds count as 0 wpm */
+    void roll(std::uint64_t now) {
+        if (start_ns == 0 || now < start_ns) { return; }
+        const std::uint64_t second = (now - start_ns) / std::nano::den;
+        for (; bucket < second; bucket++) {
+            push(static_cast<double>(bucket_chars) * 60.0 / static_cast<double>(chars_per_word));
+            bucket_chars = 0;
+        }
+    }
+
+    [[nodiscard]] bool started() const { return start_ns != 0; }
+    [[nodiscard]] std::uint64_t start_time() const { return start_ns; }
+    [[nodiscard]] std::uint64_t correct() const { return correct_keystrokes; }
+    [[nodiscard]] std::uint64_t total() const { return keystrokes; }
+
+    /* correct_chars is what counts towards net wpm, modes without words just pass correct() */
+    [[nodiscard]] TestResult result(std::uint64_t correct_chars, std::uint64_t now) const {
+        TestResult r{};
+        if (start_ns == 0 || now <= start_ns) { return r; }
+        const long double minutes = static_cast<long double>(now - start_ns) / (std::nano::den * 60.0L);
+        r.wpm = static_cast<long double>(correct_chars) / chars_per_word / minutes;
+        r.raw = static_cast<long double>(keystrokes) / chars_per_word / minutes;
+        r.accuracy = keystrokes == 0 ? 0.0L : 100.0L * static_cast<long double>(correct_keystrokes) / static_cast<long double>(keystrokes);
+        r.consistency = consistency();
+        return r;
+    }
+
+private:
+    void push(double x) {
+        samples++;
+        const double delta = x - mean;
+        mean += delta / static_cast<double>(samples);
+        m2 += delta * (x - mean);
+    }
+
+    /* monkeytype's kogasa mapping of the coefficient of variation to a percentage */
+    [[nodiscard]] long double consistency() const {
+        if (samples < 2 || mean <= 0.0) { return 0.0L; }
+        const double cov = std::sqrt(m2 / static_cast<double>(samples - 1)) / mean;
+        return 100.0L * (1.0L - std::tanh(cov + std::pow(cov, 3) / 3.0 + std::pow(cov, 5) / 5.0));
+    }
+
+    std::uint64_t start_ns = 0, keystrokes = 0, correct_keystrokes = 0;
+    std::uint64_t bucket = 0, bucket_chars = 0;
+    std::uint64_t samples = 0;
+    double mean = 0.0, m2 = 0.0;
+};
+
 struct RGB {
     std::uint16_t r, g, b;
 };
@@ -148,8 +302,14 @@ std::unordered_map<std::string, std::string> config = {
     {"theme", ""}, {"name", ""}, {"language", ""},
     {"base_color_id", "200"},
     {"caret_wait", "6250"}, {"hide_caret", "false"}, {"smooth_caret", "true"}, {"xterm_support", "true"},
-    {"show_decimal_places", "false"}
+    {"show_decimal_places", "false"},
+    {"seed", "0"}, {"frequency_weighted", "false"}, {"word_source", "random"},
+    {"asset_host", "https://monkeytype.com"}, {"offline", "false"}, {"insecure_tls", "false"},
+    {"render_backend", "ncurses"}, {"max_fps", "120"},
+    {"custom_time", "45"}, {"custom_text", ""}
 };
+/* may be left empty, every other option has to be set */
+const std::set<std::string> optional_config = {"custom_text"};
 /* ----- */
 
 /* copied from rapidfuzz github */
@@ -178,6 +338,155 @@ std::optional<std::pair<Sentence2, double>> extract_one(const Sentence1 &query,
     return std::make_pair(best_match, best_score);
 }
 
+/* type to filter over a fixed list of choices, for the pickers */
+/* a choice matches when the query is a case insensitive subsequence of it, matches are ranked by rapidfuzz ratio */
+/* matches only shrink as the query grows, so a keystroke filters the survivors of the previous query and backspace pops back to them */
+class FuzzyIndex {
+public:
+    explicit FuzzyIndex(std::vector<std::string> choices_in) : choices(std::move(choices_in)) {
+        lowered.reserve(choices.size());
+        for (const std::string &choice : choices) {
+            std::string low(choice);
+            std::transform(low.begin(), low.end(), low.begin(), [](unsigned char c) { return std::tolower(c); });
+            lowered.push_back(std::move(low));
+        }
+        chunks.reserve((choices.size() + chunk_size - 1) / chunk_size);
+        for (std::size_t begin = 0; begin < choices.size(); begin += chunk_size) {
+            chunks.emplace_back(lowered, static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(std::min(choices.size(), begin + chunk_size)));
+        }
+        std::vector<std::uint32_t> all(choices.size());
+        std::iota(all.begin(), all.end(), 0);
+        steps.emplace_back("", std::move(all));
+    }
+
+    [[nodiscard]] std::size_t size() const { return choices.size(); }
+    [[nodiscard]] const std::string &operator[](std::uint32_t id) const { return choices[id]; }
+
+    /* best k matching ids for query, best first, the list order when the query is empty */
+    const std::vector<std::uint32_t> &update(std::string query, std::size_t k) {
+        std::transform(query.begin(), query.end(), query.begin(), [](unsigned char c) { return std::tolower(c); });
+        while (!query.starts_with(steps.back().first)) { steps.pop_back(); }
+        for (std::size_t len = steps.back().first.size() + 1; len <= query.size(); len++) {
+            const std::string prefix = query.substr(0, len);
+            std::vector<std::uint32_t> survivors;
+            for (const std::uint32_t id : steps.back().second) {
+                if (is_subsequence(prefix, lowered[id])) { survivors.push_back(id); }
+            }
+            steps.emplace_back(prefix, std::move(survivors));
+        }
+
+        const std::vector<std::uint32_t> &survivors = steps.back().second;
+        top.clear();
+        if (query.empty()) {
+            top.assign(survivors.begin(), survivors.begin() + static_cast<std::ptrdiff_t>(std::min(k, survivors.size())));
+            return top;
+        }
+
+        /* survivors are sorted by id, so each chunk owns a contiguous run of them */
+        const rapidfuzz::fuzz::CachedRatio<char> cached(query);
+        auto rank = [&](std::size_t first_chunk, std::size_t last_chunk, std::vector<std::pair<double, std::uint32_t>> &out) {
+            std::vector<double> scores;
+            auto it = std::lower_bound(survivors.begin(), survivors.end(), chunks[first_chunk].begin);
+            for (std::size_t c = first_chunk; c < last_chunk && it != survivors.end(); c++) {
+                const Chunk &chunk = chunks[c];
+                if (*it >= chunk.end) { continue; }
+                chunk.score(query, cached, lowered, scores);
+                for (; it != survivors.end() && *it < chunk.end; ++it) {
+                    out.emplace_back(scores[*it - chunk.begin], *it);
+                }
+            }
+            const std::size_t keep = std::min(k, out.size());
+            std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(keep), out.end(), better);
+            out.resize(keep);
+        };
+
+        std::vector<std::pair<double, std::uint32_t>> best;
+        const std::size_t threads = std::min<std::size_t>(std::thread::hardware_concurrency(), chunks.size());
+        if (survivors.size() < parallel_threshold || threads < 2) {
+            rank(0, chunks.size(), best);
+        } else {
+            std::vector<std::vector<std::pair<double, std::uint32_t>>> partial(threads);
+            {
+                std::vector<std::jthread> workers;
+                for (std::size_t t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t]() { rank(chunks.size() * t / threads, chunks.size() * (t + 1) / threads, partial[t]); });
+                }
+            }
+            for (const auto &p : partial) { best.insert(best.end(), p.begin(), p.end()); }
+            const std::size_t keep = std::min(k, best.size());
+            std::partial_sort(best.begin(), best.begin() + static_cast<std::ptrdiff_t>(keep), best.end(), better);
+            best.resize(keep);
+        }
+        for (const auto &[score, id] : best) { top.push_back(id); }
+        return top;
+    }
+
+private:
+    static constexpr std::size_t chunk_size = 1024, parallel_threshold = 8192;
+    static constexpr std::size_t simd_max_len = 64;
+
+    /* a run of choices scored together, through rapidfuzz's simd multi scorer when it was built with one */
+    struct Chunk {
+        std::uint32_t begin, end;
+#ifdef RAPIDFUZZ_SIMD
+        rapidfuzz::experimental::MultiRatio<simd_max_len> multi;
+        std::vector<std::int32_t> slot; /* index into the multi scorer results, -1 for choices too long for it */
+#endif
+
+        Chunk([[maybe_unused]] const std::vector<std::string> &lowered, std::uint32_t begin, std::uint32_t end) : begin(begin), end(end)
+#ifdef RAPIDFUZZ_SIMD
+            , multi(static_cast<std::size_t>(std::count_if(lowered.begin() + begin, lowered.begin() + end, [](const std::string &s) { return s.size() <= simd_max_len; })))
+#endif
+        {
+#ifdef RAPIDFUZZ_SIMD
+            std::int32_t next = 0;
+            for (std::uint32_t id = begin; id < end; id++) {
+                if (lowered[id].size() <= simd_max_len) {
+                    multi.insert(lowered[id]);
+                    slot.push_back(next++);
+                } else {
+                    slot.push_back(-1);
+                }
+            }
+#endif
+        }
+
+        void score(const std::string &query, const rapidfuzz::fuzz::CachedRatio<char> &cached, const std::vector<std::string> &lowered, std::vector<double> &out) const {
+            out.assign(end - begin, 0.0);
+#ifdef RAPIDFUZZ_SIMD
+            std::vector<double> batch(multi.result_count());
+            multi.similarity(batch.data(), batch.size(), query);
+            for (std::uint32_t i = 0; i < end - begin; i++) {
+                out[i] = slot[i] >= 0 ? batch[slot[i]] : cached.similarity(lowered[begin + i]);
+            }
+#else
+            (void)query;
+            for (std::uint32_t i = 0; i < end - begin; i++) {
+                out[i] = cached.similarity(lowered[begin + i]);
+            }
+#endif
+        }
+    };
+
+    static bool is_subsequence(std::string_view needle, std::string_view haystack) {
+        std::size_t at = 0;
+        for (const char c : haystack) {
+            if (at < needle.size() && needle[at] == c) { at++; }
+        }
+        return at == needle.size();
+    }
+
+    /* higher score first, then list order */
+    static bool better(const std::pair<double, std::uint32_t> &a, const std::pair<double, std::uint32_t> &b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    }
+
+    std::vector<std::string> choices, lowered;
+    std::vector<Chunk> chunks;
+    std::vector<std::pair<std::string, std::vector<std::uint32_t>>> steps; /* query prefix and what still matches it */
+    std::vector<std::uint32_t> top;
+};
+
 bool str_startswith(const std::string &src, const std::string &match) {
     return src.length() >= match.length() ? src.substr(0, match.length()) == match : false;
 }
@@ -243,13 +552,13 @@ WINDOW* init_ncurses() {
 }
 
 void deinit_ncurses() {
+    if (stdscr == nullptr) { return; } /* a command line mode that never started ncurses */
     clear();
     endwin();
 }
 
 
 /* const std::array<char, 4> block{"■"}; */
-static constexpr long double chars_per_word = 5.0;
 
 
 void split(const std::string &s, const std::string &delim, std::vector<std::string> &outs) {
@@ -323,307 +632,2418 @@ std::int64_t str_rdll(const std::string &name, const std::string &origin) {
     return r;
 }
 
-void outch(const chinfo_t &bchar, const Theme &theme) {
-    if (bchar.state == chstate::err) {
-        nccon(theme.colorful_error_pair);
-        addch(bchar.ch);
-        nccoff(theme.colorful_error_pair);
-    } else if (bchar.state == chstate::err_extra) {
-        nccon(theme.colorful_error_extra_pair);
-        addch(bchar.ch);
-        nccoff(theme.colorful_error_extra_pair);
-    } else if (bchar.state == chstate::correct) {
+/* typed snapshot of config, parsed and validated once by load_settings so hot paths never touch the string map */
+struct Settings {
+    std::string theme, name, language, word_source, asset_host, render_backend, custom_text;
+    std::int64_t base_color_id = 0, caret_wait = 0, seed = 0, max_fps = 0, custom_time = 0;
+    bool hide_caret = false, smooth_caret = false, xterm_support = false, show_decimal_places = false, frequency_weighted = false, offline = false, insecure_tls = false;
+};
+
+/* only ever replaced whole by load_settings, a change of option goes through config and save_config_option */
+Settings settings_snapshot{};
+
+inline const Settings &settings() { return settings_snapshot; }
+
+/* exits on the first malformed option, like str_rdb and str_rdll */
+void load_settings() {
+    Settings s{};
+    s.theme = config["theme"];
+    s.name = config["name"];
+    s.language = config["language"];
+    s.base_color_id = str_rdll("base_color_id", "load_settings");
+    s.caret_wait = str_rdll("caret_wait", "load_settings");
+    s.hide_caret = str_rdb("hide_caret", "load_settings");
+    s.smooth_caret = str_rdb("smooth_caret", "load_settings");
+    s.xterm_support = str_rdb("xterm_support", "load_settings");
+    s.show_decimal_places = str_rdb("show_decimal_places", "load_settings");
+    s.seed = str_rdll("seed", "load_settings");
+    s.frequency_weighted = str_rdb("frequency_weighted", "load_settings");
+    s.word_source = config["word_source"];
+    s.asset_host = config["asset_host"];
+    s.offline = str_rdb("offline", "load_settings");
+    s.insecure_tls = str_rdb("insecure_tls", "load_settings");
+    s.render_backend = config["render_backend"];
+    s.max_fps = str_rdll("max_fps", "load_settings");
+    s.custom_time = str_rdll("custom_time", "load_settings");
+    s.custom_text = config["custom_text"];
+    if (s.custom_text.starts_with("~/") && std::getenv("HOME") != nullptr) {
+        s.custom_text = std::getenv("HOME") + s.custom_text.substr(1);
+    }
+
+    if (s.base_color_id < 0 || s.base_color_id + 32 > std::numeric_limits<std::int16_t>::max()) {
+        deinit_ncurses();
+        std::cerr << "fatal: load_settings: option base_color_id value " << s.base_color_id << " out of range\n";
+        exit(1);
+    }
+    if (s.caret_wait < 0) {
+        deinit_ncurses();
+        std::cerr << "fatal: load_settings: option caret_wait value " << s.caret_wait << " must not be negative\n";
+        exit(1);
+    }
+    if (!s.asset_host.starts_with("http://") && !s.asset_host.starts_with("https://")) {
+        deinit_ncurses();
+        std::cerr << "fatal: load_settings: option asset_host value \"" << s.asset_host << "\" must start with http:// or https://\n";
+        exit(1);
+    }
+    if (s.max_fps <= 0 || s.max_fps > 1000) {
+        deinit_ncurses();
+        std::cerr << "fatal: load_settings: option max_fps value " << s.max_fps << " out of range (1-1000)\n";
+        exit(1);
+    }
+    if (s.custom_time <= 0 || s.custom_time > 86400) {
+        deinit_ncurses();
+        std::cerr << "fatal: load_settings: option custom_time value " << s.custom_time << " out of range (1-86400 seconds)\n";
+        exit(1);
+    }
+    if (s.render_backend != "ncurses" && s.render_backend != "truecolor") {
+        deinit_ncurses();
+        std::cerr << "fatal: load_settings: option render_backend value \"" << s.render_backend << "\" must be ncurses or truecolor\n";
+        exit(1);
+    }
+    if (s.word_source != "random" && s.word_source != "weakness") {
+        deinit_ncurses();
+        std::cerr << "fatal: load_settings: option word_source value \"" << s.word_source << "\" must be random or weakness\n";
+        exit(1);
+    }
+    settings_snapshot = std::move(s);
+}
+
+/* writes a run of chars sharing one state with a single color toggle, the cursor is left after it */
+void outrun(std::string_view run, chstate state, const Theme &theme) {
+    std::int16_t pair = theme.sub_pair;
+    if (state == chstate::err) {
+        pair = theme.colorful_error_pair;
+    } else if (state == chstate::err_extra) {
+        pair = theme.colorful_error_extra_pair;
+    } else if (state == chstate::correct) {
         /* RGB rgb = hsl_to_rgb(static_cast<double>(static_cast<long double>(get_current_time_ns()) / 1000000.0L), 1.0, 0.5);
         if (theme.name == "rgb") {
             addstr((std::string("\x1b[38;2;") + std::to_string(rgb.r) + ";" + std::to_string(rgb.g) + ";" + std::to_string(rgb.b) + "m").c_str());
         } */
-        nccon(theme.main_pair);
-        addch(bchar.ch);
-        nccoff(theme.main_pair);
-    } else {
-        nccon(theme.sub_pair);
-        addch(bchar.ch);
-        nccoff(theme.sub_pair);
+        pair = theme.main_pair;
     }
+    nccon(pair);
+    addnstr(run.data(), static_cast<int>(run.size()));
+    nccoff(pair);
 }
 
-template <std::size_t N>
-void animate_caret(std::mutex &term_mutex, std::int32_t y, std::int32_t p, std::int32_t chars_covering, bool forwards, std::vector<std::uint64_t> &times, const Theme &theme, std::vector<chinfo_t> &buf, std::int32_t pword, std::bitset<N> &incorrect_words, const std::string &origin) {
-    static thread_local std::int32_t last_p = 0;
-    const std::uint64_t rdcaret_wait = str_rdll("caret_wait", origin);
-    if (str_rdb("smooth_caret", origin)) {
-        auto caret_wait = [&]() -> std::uint64_t {
-            std::lock_guard guard(term_mutex);
-            const std::uint64_t times_wait = (times.size() > 1 ? (times[times.size() - 1] - times[times.size() - 2]) / ((static_cast<std::int32_t>(forwards) * 2 - 1) * (chars_covering) * 15'000) : rdcaret_wait);
-            return std::min<std::uint64_t>(rdcaret_wait, times_wait);
-        };
-        if (p > 0 && forwards) {
-            for (int i = 0; i < 8; i++) {
-                {
-                    std::lock_guard guard(term_mutex);
-                    curs_set(0);
-                    move(y + (p - 1) / COLS, (p - 1) % COLS);
-                    nccon(theme.caret_pair);
-                    printw("%lc", get_unicode_caret(i));
-                    nccoff(theme.caret_pair);
-                    move(y + (p - 1) / COLS, (p - 1) % COLS);
-                    refresh();
-                }
-                std::this_thread::sleep_for(std::chrono::microseconds(caret_wait()));
-            }
-            for (int i = 0; i < 7; i++) {
-                {
-                    std::lock_guard guard(term_mutex);
-                    curs_set(0);
-                    move(y + (p - 1) / COLS, (p - 1) % COLS);
-                    nccon(theme.caret_inverse_pair);
-                    printw("%lc", get_unicode_caret(i));
-                    nccoff(theme.caret_inverse_pair);
-                    move(y + (p - 1) / COLS, (p - 1) % COLS);
-                    refresh();
-                }
-                std::this_thread::sleep_for(std::chrono::microseconds(caret_wait()));
-            }
+void outch(const chinfo_t &bchar, const Theme &theme) {
+    outrun(std::string_view(&bchar.ch, 1), bchar.state, theme);
+}
 
-        } else if (!forwards) {
-            for (int i = 7; i >= 0; i--) {
-                {
-                    std::lock_guard guard(term_mutex);
-                    curs_set(0);
-                    move(y + p / COLS, p % COLS);
-                    nccon(theme.caret_inverse_pair);
-                    printw("%lc", get_unicode_caret(i));
-                    nccoff(theme.caret_inverse_pair);
-                    move(y + p / COLS, p % COLS);
-                    refresh();
-                }
-                std::this_thread::sleep_for(std::chrono::microseconds(caret_wait()));
-            }
-            for (int i = 7; i >= 1; i--) {
-                {
-                    std::lock_guard guard(term_mutex);
-                    curs_set(0);
-                    move(y + p / COLS, p % COLS);
-                    nccon(theme.caret_pair);
-                    printw("%lc", get_unicode_caret(i));
-                    nccoff(theme.caret_pair);
-                    move(y + p / COLS, p % COLS);
-                    refresh();
-                }
-                std::this_thread::sleep_for(std::chrono::microseconds(caret_wait()));
-            }
+/* render_backend=truecolor: the typing surface is written as pre-built 24-bit sgr escapes straight to the terminal, */
+/* collected into one buffer and sent with one write() per frame, so glyphs skip nccon/nccoff and the color pairs */
+/* ncurses keeps reading input and drawing everything else, and is told to repaint the whole screen once this is gone */
+class DirectTerminal {
+public:
+    explicit DirectTerminal(const Theme &theme) {
+        const auto sgr = [&](const RGB &fg, bool underline) {
+            return "\x1b[0;" + std::string(underline ? "4;" : "") + "38;2;" + channels(fg) + ";48;2;" + channels(theme.bg) + "m";
+        };
+        /* same colors outch picks for each state */
+        const std::array<const RGB *, 4> state_colors = {&theme.sub, &theme.main, &theme.colorful_error, &theme.colorful_error_extra};
+        for (std::size_t s = 0; s < state_colors.size(); s++) {
+            styles[s * 2] = sgr(*state_colors[s], false);
+            styles[s * 2 + 1] = sgr(*state_colors[s], true);
         }
-        std::lock_guard guard(term_mutex);
-        std::int32_t cw = 0;
-        std::int32_t ep = p + (static_cast<std::int32_t>(!forwards) - 1);
-        for (std::int32_t i = 0; i <= ep; i++) {
-            if (buf[i].ch == ' ') {
-                cw++;
-            }
+        caret_style = sgr(theme.caret, false);
+        caret_inverse_style = "\x1b[0;38;2;" + channels(theme.bg) + ";48;2;" + channels(theme.caret) + "m";
+
+        /* ncurses already reads unbuffered, output post processing is all that is left to turn off */
+        if (tcgetattr(STDOUT_FILENO, &saved) == 0) {
+            termios raw = saved;
+            raw.c_oflag &= ~static_cast<tcflag_t>(OPOST);
+            raw.c_lflag &= ~static_cast<tcflag_t>(ICANON | ECHO);
+            restore = tcsetattr(STDOUT_FILENO, TCSANOW, &raw) == 0;
         }
+        out.reserve(4096);
+        out += "\x1b[?25l";
+    }
 
-        curs_set(0);
-        if (incorrect_words[cw] && cw < pword && buf[ep].ch != ' ') {
-            attron(A_UNDERLINE);
-        }
-        move(y + ep / COLS, ep % COLS);
-        outch(buf[ep], theme);
-        if (incorrect_words[cw] && cw < pword && buf[ep].ch != ' ') {
-            attroff(A_UNDERLINE);
-        }
-        last_p = p;
+    DirectTerminal(const DirectTerminal &) = delete;
+    DirectTerminal &operator=(const DirectTerminal &) = delete;
+
+    ~DirectTerminal() {
+        out += "\x1b[0m";
+        flush();
+        if (restore) { tcsetattr(STDOUT_FILENO, TCSANOW, &saved); }
+        clearok(curscr, true);
     }
 
-    std::lock_guard guard(term_mutex);
-    if (str_rdb("xterm_support", "mode words")) {
-        curs_set(1);
-        move(y + p / COLS, p % COLS);
-        set_cursor_type(CursorType::steady_bar_xterm);
-    } else {
-        curs_set(0);
-        nccon(theme.caret_pair);
-        if (p > 0) {
-            mvprintw(y + p / COLS, p - 1, "%lc", get_unicode_caret(8));
-        }
-        nccoff(theme.caret_pair);
+    void put(std::int32_t row, std::int32_t col, char ch, chstate state, bool underline) {
+        move_to(row, col);
+        style(styles[state * 2 + static_cast<unsigned int>(underline)]);
+        out.push_back(ch);
+        advance();
     }
-    refresh();
-}
 
+    void put_caret(std::int32_t row, std::int32_t col, std::uint32_t index, bool inverse) {
+        move_to(row, col);
+        style(inverse ? caret_inverse_style : caret_style);
+        append_utf8(static_cast<char32_t>(get_unicode_caret(index)));
+        advance();
+    }
 
-/* will fetch from monkeytype if not exist locally */
-/* filename should not have beginning */
-/* origin is where it is called from for errors */
-void fetch_file(const std::string &filename, const std::string &origin) {
-    if (file_exists(filename)) {
-        return;
+    /* text in the untyped color, then cleared to the end of the line */
+    void text(std::int32_t row, std::int32_t col, std::string_view s) {
+        move_to(row, col);
+        style(styles[chstate::original * 2]);
+        out.append(s);
+        out += "\x1b[K";
+        cursor_col = -1;
     }
 
-    printw("info: %s: fetching monkeytype.com/%s\n", origin.c_str(), filename.c_str());
-    getch();
-    refresh();
+    /* the terminal's own cursor, for xterm_support */
+    void show_cursor(std::int32_t row, std::int32_t col) {
+        move_to(row, col);
+        out += "\x1b[?25h";
+    }
 
-    httplib::SSLClient cli("monkeytype.com");
-    cli.enable_server_certificate_verification(false);
-    auto resp = cli.Get("/" + filename);
-    if (!resp) {
-        std::stringstream s;
-        s << resp.error();
-        deinit_ncurses();
-        std::cerr << "fatal: " << origin << ": fetch for " << filename << " failed with httplib error " << s.str() << '\n';
-        exit(1);
+    void hide_cursor() { out += "\x1b[?25l"; }
+
+    /* the whole screen in the background color, after a resize */
+    void clear() {
+        style(styles[chstate::original * 2]);
+        out += "\x1b[2J";
+        cursor_row = cursor_col = -1;
     }
 
-    if (resp->status != 200) {
-        deinit_ncurses();
-        std::cerr << "fatal: " << origin << ": fetch for " << filename << " failed with status " << resp->status << '\n';
-        exit(1);
+    void flush() {
+        std::size_t done = 0;
+        while (done < out.size()) {
+            const ssize_t n = write(STDOUT_FILENO, out.data() + done, out.size() - done);
+            if (n < 0 && errno == EINTR) { continue; }
+            if (n <= 0) { break; }
+            done += static_cast<std::size_t>(n);
+        }
+        out.clear();
     }
 
-    std::string text = resp->body;
-    if (text.substr(0, 9) == "<!doctype") { /* returned nice looking html 404 page */
-        deinit_ncurses();
-        std::cerr << "fatal: " << origin << ": fetch for " << filename << " failed with status 400\n";
-        exit(1);
+private:
+    /* theme colors run 0 to 256, see strhex_to_rgb */
+    static std::string channels(const RGB &c) {
+        const auto to8 = [](std::uint16_t v) { return std::to_string(std::min(255, v * 255 / 256)); };
+        return to8(c.r) + ";" + to8(c.g) + ";" + to8(c.b);
     }
 
-    std::ofstream outfile(filename);
-    outfile << text;
-    outfile.close();
-}
+    /* a cup escape is only sent when the next cell is not where the last one left the cursor */
+    void move_to(std::int32_t row, std::int32_t col) {
+        if (row == cursor_row && col == cursor_col) { return; }
+        out += "\x1b[" + std::to_string(row + 1) + ";" + std::to_string(col + 1) + "H";
+        cursor_row = row;
+        cursor_col = col;
+    }
 
-std::string get_file_content(const std::string &filename) {
-    std::ifstream file(filename);
-    std::stringstream ss;
-    ss << file.rdbuf();
-    std::string text = ss.str();
-    file.close();
-    return text;
-}
+    /* the last column leaves a pending wrap, so the cursor position is unknown until the next cup */
+    void advance() {
+        cursor_col = cursor_col + 1 >= COLS ? -1 : cursor_col + 1;
+    }
 
-void get_quotes(std::vector<std::string> &outs, Quote size) {
-    /* "quotes": [ */
-    /*     { */
-    /*         "text": "You can't use the fire exit because you're not made of fire.", */
-    /*         "source": "Undertale", */
-    /*         "id": 12, */
-    /*         "length": 60 */
-    /*     } */
-    /* ] */
+    void style(const std::string &sgr) {
+        if (current == &sgr) { return; }
+        out += sgr;
+        current = &sgr;
+    }
 
-    const std::string quotes_filename = "quotes/" + config["language"] + ".json";
-    fetch_file(quotes_filename, "get_quotes");
-    std::FILE *pfile = std::fopen(quotes_filename.c_str(), "r");
-    rapidjson::Document doc;
-    const std::uintmax_t fsize = std::filesystem::file_size(quotes_filename);
-    char *contents = new char[fsize];
-    rapidjson::FileReadStream frs(pfile, contents, fsize);
-    doc.ParseStream(frs);
+    void append_utf8(char32_t c) {
+        if (c < 0x80) {
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
 
-    std::fclose(pfile);
-    delete[] contents;
-    std::int32_t group_begin = doc["groups"][size][0].GetInt(), group_end = doc["groups"][size][1].GetInt();
-    for (const auto &quote : doc["quotes"].GetArray()) {
-        const rapidjson::SizeType len = quote["text"].GetStringLength();
-        if (len >= group_begin && len < group_end) {
-            outs.emplace_back(quote["text"].GetString());
+    std::array<std::string, 8> styles; /* by chstate, then underline */
+    std::string caret_style, caret_inverse_style;
+    const std::string *current = nullptr;
+    std::string out;
+    std::int32_t cursor_row = -1, cursor_col = -1;
+    termios saved{};
+    bool restore = false;
+};
+
+/* per word tallies for a typing test, kept up to date in O(1) per keystroke and backspace */
+/* words before current() have been passed, so their untyped chars count as missed */
+class Scorer {
+public:
+    struct Word {
+        std::uint32_t length = 0, correct = 0, incorrect = 0, extra = 0;
+    };
+
+    explicit Scorer(std::string_view text) {
+        words.emplace_back();
+        for (const char c : text) {
+            if (c == ' ') {
+                words.emplace_back();
+            } else {
+                words.back().length++;
+            }
         }
     }
-}
 
-void get_words(std::vector<std::string> &outs) {
-    const std::string words_filename = "languages/" + config["language"] + ".json";
-    fetch_file(words_filename, "get_words");
-    std::FILE *pfile = std::fopen(words_filename.c_str(), "r");
-    rapidjson::Document doc;
-    const std::uintmax_t fsize = std::filesystem::file_size(words_filename);
-    char *contents = new char[fsize];
-    rapidjson::FileReadStream frs(pfile, contents, fsize);
-    doc.ParseStream(frs);
-    for (const auto &word : doc["words"].GetArray()) {
-        outs.emplace_back(word.GetString());
+    void correct(std::uint32_t w) { words[w].correct++; correct_total++; }
+    void incorrect(std::uint32_t w) { words[w].incorrect++; incorrect_total++; }
+    void extra(std::uint32_t w) { words[w].extra++; extra_total++; }
+    void unextra(std::uint32_t w) { words[w].extra--; extra_total--; }
+
+    /* backspace over an original char of w that was typed as was */
+    void untype(std::uint32_t w, chstate was) {
+        if (was == chstate::correct) {
+            words[w].correct--;
+            correct_total--;
+        } else if (was == chstate::err) {
+            words[w].incorrect--;
+            incorrect_total--;
+        }
     }
-    std::fclose(pfile);
-    delete[] contents;
-}
 
+    /* crossing a space forwards and backwards, a passed word can't change until it is retreated into again */
+    /* skipping the last word advances past it too, closing it like a space would, only without a space to count */
+    void advance() {
+        missed_total += unfilled(current);
+        if (clean(current)) { correct_word_total += closed_length(current); }
+        current++;
+    }
 
-void get_themes_list(std::vector<std::string> &outs) {
-    /* [ */
-    /*     { */
-    /*         "name": "oblivion", */
-    /*         "bgColor": "#313231", */
-    /*         "mainColor": "#a5a096", */
-    /*         "subColor": "#5d6263", */
-    /*         "textColor": "#f7f5f1" */
-    /*     } */
-    /* ] */
-    
-    const std::string list_filename = "themes/_list.json";
-    fetch_file(list_filename, "get_themes_list");
-    std::FILE *pfile = std::fopen(list_filename.c_str(), "r");
-    rapidjson::Document doc;
-    const std::uintmax_t size = std::filesystem::file_size(list_filename);
-    char *contents = new char[size];
-    rapidjson::FileReadStream frs(pfile, contents, size);
-    doc.ParseStream(frs);
-    for (const auto &theme : doc.GetArray()) {
-        outs.emplace_back(theme["name"].GetString());
+    void retreat() {
+        current--;
+        missed_total -= unfilled(current);
+        if (clean(current)) { correct_word_total -= closed_length(current); }
     }
-    std::fclose(pfile);
-    delete[] contents;
-}
 
-/* will assign color ids up to base + 30, color pairs up to base + 32 */
-void assign_theme(const std::int16_t &base, Theme &theme) {
-    /* NOLINTBEGIN */
-    pair_init(base, base + 1, base + 2, theme.main, theme.bg);
-    theme.main_pair = base;
-    pair_init(base + 3, base + 4, base + 5, theme.caret, theme.bg);
-    theme.caret_pair = base + 3;
-    pair_init(base + 6, base + 7, base + 8, theme.sub, theme.bg);
-    theme.sub_pair = base + 6;
-    pair_init(base + 9, base + 10, base + 11, theme.sub_alt, theme.bg);
-    theme.sub_alt_pair = base + 9;
-    pair_init(base + 12, base + 13, base + 14, theme.text, theme.bg);
-    theme.text_pair = base + 12;
-    pair_init(base + 15, base + 16, base + 17, theme.error, theme.bg);
-    theme.error_pair = base + 15;
-    pair_init(base + 18, base + 19, base + 20, theme.error_extra, theme.bg);
-    theme.error_extra_pair = base + 18;
-    pair_init(base + 21, base + 22, base + 23, theme.colorful_error, theme.bg);
-    theme.colorful_error_pair = base + 21;
-    pair_init(base + 24, base + 25, base + 26, theme.colorful_error_extra, theme.bg);
-    theme.colorful_error_extra_pair = base + 24;
+    [[nodiscard]] std::uint32_t current_word() const { return current; }
+    [[nodiscard]] std::size_t word_count() const { return words.size(); }
+    [[nodiscard]] const Word &word(std::uint32_t w) const { return words[w]; }
 
-    pair_init(base + 27, base + 28, base + 29, theme.bg, theme.bg);
-    theme.bg_pair = base + 27;
+    [[nodiscard]] std::uint32_t missed(std::uint32_t w) const { return w < current ? unfilled(w) : 0; }
 
-    pair_init(base + 30, base + 31, base + 32, theme.bg, theme.caret);
-    theme.caret_inverse_pair = base + 30;
-    /* NOLINTEND */
-}
+    [[nodiscard]] bool is_incorrect(std::uint32_t w) const {
+        return words[w].incorrect > 0 || words[w].extra > 0 || missed(w) > 0;
+    }
 
+    /* passed words with any mistake in them */
+    [[nodiscard]] bool underlined(std::uint32_t w) const { return w < current && is_incorrect(w); }
 
-void get_theme(const std::string &name, Theme &theme) {
-    const std::string theme_filename = "themes/" + name + ".css";
-    std::string text;
+    [[nodiscard]] std::uint64_t correct_chars() const { return correct_total; }
+    [[nodiscard]] std::uint64_t incorrect_chars() const { return incorrect_total; }
+    [[nodiscard]] std::uint64_t extra_chars() const { return extra_total; }
+    [[nodiscard]] std::uint64_t missed_chars() const { return missed_total; }
 
-    if (name == "custom") { /* we do not want to fetch */
-        if (!file_exists(theme_filename)) {
-            deinit_ncurses();
-            std::cerr << "fatal: get_theme: custom theme custom.css file does not exist\n";
-            exit(1);
-        }
-    } else {
-        fetch_file(theme_filename, "get_theme");
+    /* what monkeytype counts towards wpm: chars and spaces of correctly typed words, plus the current word so far if it has no mistakes yet */
+    [[nodiscard]] std::uint64_t correct_word_chars() const {
+        if (current >= words.size()) { return correct_word_total; }
+        const Word &cur = words[current];
+        return correct_word_total + (cur.incorrect == 0 && cur.extra == 0 ? cur.correct : 0);
     }
 
-    text = get_file_content(theme_filename);
+private:
+    [[nodiscard]] std::uint32_t closed_length(std::uint32_t w) const { return words[w].length + static_cast<std::uint32_t>(w + 1 < words.size()); }
+    [[nodiscard]] std::uint32_t unfilled(std::uint32_t w) const { return words[w].length - words[w].correct - words[w].incorrect; }
+    [[nodiscard]] bool clean(std::uint32_t w) const { return words[w].incorrect == 0 && words[w].extra == 0 && words[w].correct == words[w].length; }
 
-    /* parse this better, not all css define in the same order */
-    std::vector<std::string> fcolors, tcolors, colors;
-    std::size_t beginb = text.find(":root{") + 5, endb = text.find('}', beginb);
+    std::vector<Word> words;
+    std::uint32_t current = 0;
+    std::uint64_t correct_total = 0, incorrect_total = 0, extra_total = 0, missed_total = 0, correct_word_total = 0;
+};
+
+/* where every char of a typing test goes on screen: words wrap whole onto the next row, a word longer than a row is split */
+/* a unit is a word with the space after it, the tables per unit and per row make locating any char O(1) */
+/* an extra char only re-places units from its own until the breaks line up again, a resize lays everything out again */
+class TextLayout {
+public:
+    /* width columns, height rows of viewport */
+    void reset(const TextBuffer &buf, std::int32_t width, std::int32_t height) {
+        cols = std::max(width, 2);
+        rows = std::max(height, 1);
+        size = buf.size();
+        units.clear();
+        for (std::size_t i = 0; i < buf.size(); i++) {
+            const std::uint32_t w = buf[i].word;
+            if (units.size() <= w) { units.resize(w + 1); }
+            if (buf[i].ch == ' ' && w > 0) {
+                units[w].start = i + 1; /* the space before word w is the end of unit w - 1 */
+            } else {
+                units[w].length++;
+            }
+        }
+        firsts.clear();
+        place_from(0, 0);
+        top_row = 0;
+    }
+
+    /* rows before the first one that breaks differently at the new width are kept, the rest is placed again */
+    void resize(const TextBuffer &buf, std::int32_t width, std::int32_t height) {
+        rows = std::max(height, 1);
+        width = std::max(width, 2);
+        if (width == cols) { return; }
+        std::int32_t r = 0;
+        for (; r < row_count() && row_holds(buf, r, width); r++) {;}
+        cols = width;
+        if (r < row_count()) { place_from(unit_of(buf, firsts[r]), 0, false); }
+    }
+
+    /* an extra char was inserted at i (delta 1) or erased from before i (delta -1), buf already has the change */
+    void resize_unit(const TextBuffer &buf, std::uint32_t u, std::int32_t delta) {
+        size = buf.size();
+        units[u].length = static_cast<std::uint32_t>(static_cast<std::int64_t>(units[u].length) + delta);
+        for (std::size_t v = u + 1; v < units.size(); v++) { units[v].start = shift(units[v].start, delta); }
+        place_from(u, delta);
+    }
+
+    /* the unit a char belongs to, past the end is the last one */
+    [[nodiscard]] std::uint32_t unit_of(const TextBuffer &buf, std::size_t i) const {
+        if (i >= buf.size()) { return static_cast<std::uint32_t>(units.size() - 1); }
+        const std::uint32_t w = buf[i].word;
+        return buf[i].ch == ' ' && w > 0 ? w - 1 : w;
+    }
+
+    /* row and column in the whole text, i may be one past the end for a caret after the last char */
+    [[nodiscard]] std::pair<std::int32_t, std::int32_t> locate(const TextBuffer &buf, std::size_t i) const {
+        if (units.empty()) { return {0, 0}; }
+        const Unit &unit = units[unit_of(buf, i)];
+        const std::size_t off = unit.col + (i - unit.start);
+        return {static_cast<std::int32_t>(unit.row + off / cols), static_cast<std::int32_t>(off % cols)};
+    }
+
+    /* row and column on screen, relative to the viewport */
+    [[nodiscard]] std::pair<std::int32_t, std::int32_t> position(const TextBuffer &buf, std::size_t i) const {
+        const auto [row, col] = locate(buf, i);
+        return {row - top_row, col};
+    }
+
+    /* scrolls so the caret at p is in the viewport, a page at a time with the row before it kept, true if it moved */
+    bool follow(const TextBuffer &buf, std::size_t p) {
+        const std::int32_t row = locate(buf, p).first;
+        const std::int32_t before = top_row;
+        if (row < top_row) {
+            top_row = std::max(0, row - rows + 2);
+        } else if (row >= top_row + rows) {
+            top_row = row - std::min(1, rows - 1);
+        }
+        top_row = std::min(top_row, row);
+        return top_row != before;
+    }
+
+    [[nodiscard]] std::int32_t width() const { return cols; }
+    [[nodiscard]] std::int32_t height() const { return rows; }
+    [[nodiscard]] std::int32_t top() const { return top_row; }
+    [[nodiscard]] std::int32_t row_count() const { return static_cast<std::int32_t>(firsts.size()); }
+
+    /* rows of text in the viewport, the live stats go on the one after the blank below them */
+    [[nodiscard]] std::int32_t visible_rows() const { return std::clamp(row_count() - top_row, 0, rows); }
+
+    /* row r holds [first(r), first(r) + row_length(r)) starting at column 0 */
+    [[nodiscard]] std::size_t first(std::int32_t r) const { return firsts[r]; }
+    [[nodiscard]] std::size_t row_length(std::int32_t r) const { return (r + 1 < row_count() ? firsts[r + 1] : size) - firsts[r]; }
+
+private:
+    struct Unit {
+        std::size_t start = 0; /* first char after the leading space */
+        std::uint32_t length = 0; /* without the trailing space */
+        std::uint32_t row = 0, col = 0;
+    };
+
+    /* places units from u on, stops early once a unit lands where it was, everything after it only moved by delta */
+    /* resync is off when the width changed, a unit landing where it was says nothing about the ones after it then */
+    void place_from(std::uint32_t u, std::int32_t delta, bool resync = true) {
+        std::uint32_t row = 0, col = 0;
+        if (u > 0) {
+            const std::size_t end = units[u - 1].col + units[u - 1].length + 1;
+            row = units[u - 1].row + static_cast<std::uint32_t>(end / cols);
+            col = static_cast<std::uint32_t>(end % cols);
+        }
+        std::size_t count = 0; /* rows holding any char */
+        for (std::size_t v = u; v < units.size(); v++) {
+            Unit &unit = units[v];
+            const std::size_t span = std::size_t{unit.length} + 1;
+            if (col > 0 && col + span > static_cast<std::size_t>(cols)) {
+                row++;
+                col = 0;
+            }
+            if (v == u) {
+                count = col > 0 ? row + 1 : row;
+            } else if (resync && unit.row == row && unit.col == col) {
+                const std::size_t shifted_from = col == 0 ? row : row + 1;
+                for (std::size_t r = shifted_from; r < firsts.size(); r++) { firsts[r] = shift(firsts[r], delta); }
+                return;
+            }
+            unit.row = row;
+            unit.col = col;
+            /* every offset on a column 0 inside the unit starts a row */
+            for (std::size_t off = col == 0 ? 0 : cols; off < col + span; off += cols) {
+                const std::size_t i = unit.start + off - col;
+                if (i >= size) { break; }
+                const std::size_t r = row + off / cols;
+                if (firsts.size() <= r) { firsts.resize(r + 1); }
+                firsts[r] = i;
+                count = std::max(count, r + 1);
+            }
+            const std::size_t end = col + span;
+            row += static_cast<std::uint32_t>(end / cols);
+            col = static_cast<std::uint32_t>(end % cols);
+        }
+        /* ran to the end, the row count may have changed */
+        firsts.resize(count);
+    }
+
+    /* row r comes out the same at width w if it ends on a whole unit that still fits and the next unit still doesn't */
+    [[nodiscard]] bool row_holds(const TextBuffer &buf, std::int32_t r, std::int32_t w) const {
+        const std::uint32_t v = unit_of(buf, firsts[r] + row_length(r) - 1);
+        const Unit &unit = units[v];
+        const std::size_t end = unit.col + unit.length + 1;
+        if (unit.row != static_cast<std::uint32_t>(r) || end > static_cast<std::size_t>(cols) || end > static_cast<std::size_t>(w)) { return false; }
+        return v + 1 == units.size() || end + units[v + 1].length + 1 > static_cast<std::size_t>(w);
+    }
+
+    static std::size_t shift(std::size_t i, std::int32_t delta) {
+        return static_cast<std::size_t>(static_cast<std::int64_t>(i) + delta);
+    }
+
+    std::vector<Unit> units;
+    std::vector<std::size_t> firsts; /* line-break table, index of the first char of each row */
+    std::size_t size = 0;
+    std::int32_t cols = 2, rows = 1, top_row = 0;
+};
+
+/* remembers what each cell of the viewport looks like on screen, so a frame only redraws dirty cells that actually changed */
+/* only rows in the viewport are ever looked at, the rest of the text costs nothing however long it is */
+class TextRenderer {
+public:
+    /* forget what is on screen, the next flush draws every visible cell */
+    void invalidate() {
+        screen.clear();
+        mark(0, std::numeric_limits<std::size_t>::max());
+    }
+
+    /* [lo, hi) of the text */
+    void mark(std::size_t lo, std::size_t hi) {
+        dirty_lo = std::min(dirty_lo, lo);
+        dirty_hi = std::max(dirty_hi, hi);
+    }
+
+    /* caller holds term_mutex and refreshes (or flushes direct) afterwards, returns how many cells were drawn */
+    /* adjacent changed cells with the same look go out as one run, one move and one color toggle each */
+    std::size_t flush(const TextBuffer &buf, const Scorer &scorer, const TextLayout &layout, const Theme &theme, DirectTerminal *direct = nullptr) {
+        const std::int32_t width = layout.width(), height = layout.height();
+        if (screen.size() != static_cast<std::size_t>(width) * height || shown_top != layout.top()) {
+            /* scrolled or resized, every cell is somewhere else now and the whole viewport has to be drawn over */
+            screen.assign(static_cast<std::size_t>(width) * height, stale);
+            shown_top = layout.top();
+            mark(0, std::numeric_limits<std::size_t>::max());
+        }
+        if (dirty_lo >= dirty_hi) { return 0; }
+
+        std::size_t drawn = 0;
+        std::int32_t run_row = 0, run_col = 0;
+        std::string run;
+        Cell run_look{};
+        auto end_run = [&]() {
+            if (run.empty()) { return; }
+            if (run_look.underline) { attron(A_UNDERLINE); }
+            move(run_row, run_col);
+            outrun(run, run_look.state, theme);
+            if (run_look.underline) { attroff(A_UNDERLINE); }
+            run.clear();
+        };
+
+        const std::int32_t visible = layout.visible_rows();
+        const std::int32_t lo_row = buf.size() == 0 ? 0 : layout.locate(buf, std::min(dirty_lo, buf.size() - 1)).first;
+        const std::int32_t hi_row = dirty_hi >= buf.size() ? shown_top + height : layout.locate(buf, dirty_hi - 1).first + 1;
+        for (std::int32_t r = std::max(lo_row, shown_top); r < std::min(hi_row, shown_top + height); r++) {
+            const std::int32_t sr = r - shown_top;
+            Cell *row = screen.data() + static_cast<std::size_t>(sr) * width;
+            /* rows past the text are blanked once, then forgotten, so the live stats or anything else drawn there is left alone */
+            const bool text_row = sr < visible;
+            if (!text_row && row[0] == unknown) { continue; }
+            const std::size_t first = text_row ? layout.first(r) : 0;
+            const std::size_t length = text_row ? layout.row_length(r) : 0;
+
+            for (std::int32_t c = 0; c < width; c++) {
+                Cell want = blank;
+                if (static_cast<std::size_t>(c) < length) {
+                    const chinfo_t &ch = buf[first + c];
+                    want = Cell{.ch = ch.ch, .state = ch.state, .underline = ch.ch != ' ' && scorer.underlined(ch.word)};
+                }
+                if (row[c] == want) {
+                    if (!text_row) { row[c] = unknown; }
+                    end_run();
+                    continue;
+                }
+
+                if (direct != nullptr) {
+                    direct->put(sr, c, want.ch, want.state, want.underline);
+                } else {
+                    if (!run.empty() && (want.state != run_look.state || want.underline != run_look.underline)) { end_run(); }
+                    if (run.empty()) {
+                        run_row = sr;
+                        run_col = c;
+                        run_look = want;
+                    }
+                    run.push_back(want.ch);
+                }
+                drawn++;
+                row[c] = text_row ? want : unknown;
+            }
+            end_run();
+        }
+        dirty_lo = std::numeric_limits<std::size_t>::max();
+        dirty_hi = 0;
+        return drawn;
+    }
+
+private:
+    struct Cell {
+        char ch;
+        chstate state;
+        bool underline;
+
+        bool operator==(const Cell &) const = default;
+    };
+
+    static constexpr Cell unknown{.ch = '\0', .state = chstate::original, .underline = false}; /* not ours, never drawn over */
+    static constexpr Cell stale{.ch = '\1', .state = chstate::original, .underline = false}; /* ours, but what is there is not known */
+    static constexpr Cell blank{.ch = ' ', .state = chstate::original, .underline = false};
+
+    std::vector<Cell> screen; /* the viewport, row major */
+    std::int32_t shown_top = 0;
+    std::size_t dirty_lo = std::numeric_limits<std::size_t>::max(), dirty_hi = 0;
+};
+
+/* owns the terminal output of a typing test: the text renderer and the caret thread only draw into stdscr (or direct's buffer) */
+/* and invalidate, one render thread pushes that to the tty at most once per frame interval however many events came in */
+class Compositor {
+public:
+    Compositor(std::mutex &term_mutex, DirectTerminal *direct, std::chrono::nanoseconds interval)
+        : term_mutex(term_mutex), direct(direct), interval(interval), renderer([this](std::stop_token stoken) { run(stoken); }) {}
+
+    Compositor(const Compositor &) = delete;
+    Compositor &operator=(const Compositor &) = delete;
+
+    /* stops the clock, whatever is still dirty goes out first */
+    ~Compositor() {
+        renderer.request_stop();
+        renderer.join();
+    }
+
+    /* can be called from any thread, with or without term_mutex held */
+    void invalidate() {
+        {
+            std::lock_guard guard(mutex);
+            dirty = true;
+        }
+        ready.notify_one();
+    }
+
+    /* the cursor writes straight to the tty, so it is only recorded here and changed in the next present, in step with the frame */
+    /* visibility is for the ncurses path, direct queues show_cursor and hide_cursor in its own buffer */
+    void set_cursor_visible(bool visible) {
+        {
+            std::lock_guard guard(mutex);
+            cursor_visible = visible;
+            dirty = true;
+        }
+        ready.notify_one();
+    }
+
+    void set_cursor_shape(CursorType shape) {
+        {
+            std::lock_guard guard(mutex);
+            cursor_shape = shape;
+            dirty = true;
+        }
+        ready.notify_one();
+    }
+
+    [[nodiscard]] std::uint64_t frames() const { return presented; }
+
+private:
+    void run(const std::stop_token &stoken) {
+        auto next = std::chrono::steady_clock::now();
+        while (true) {
+            std::optional<bool> visible;
+            std::optional<CursorType> shape;
+            {
+                std::unique_lock guard(mutex);
+                ready.wait(guard, stoken, [&]() { return dirty; });
+                if (!dirty) { return; } /* stopped with nothing left to show */
+                dirty = false;
+                visible = std::exchange(cursor_visible, std::nullopt);
+                shape = std::exchange(cursor_shape, std::nullopt);
+            }
+            {
+                std::lock_guard guard(term_mutex);
+                /* hidden before the frame is drawn and shown after, so it never flickers over the cells being redrawn */
+                if (visible == false) { curs_set(0); }
+                if (direct != nullptr) {
+                    direct->flush();
+                } else {
+                    wnoutrefresh(stdscr);
+                    doupdate();
+                }
+                if (visible == true) { curs_set(1); }
+                if (shape.has_value()) { set_cursor_type(shape.value()); }
+                presented++;
+            }
+            /* everything drawn while sleeping is coalesced into the next frame */
+            next = std::max(next + interval, std::chrono::steady_clock::now());
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    std::mutex &term_mutex;
+    DirectTerminal *direct;
+    std::chrono::nanoseconds interval;
+
+    std::mutex mutex;
+    std::condition_variable_any ready;
+    bool dirty = false;
+    std::optional<bool> cursor_visible;
+    std::optional<CursorType> cursor_shape;
+    std::atomic_uint64_t presented = 0;
+    std::jthread renderer; /* last, so it starts after the rest is ready */
+};
+
+/* sub-frames are paced on a fixed frame clock, and whatever is left of them is dropped as soon as epoch moves past seen */
+void animate_caret(std::mutex &term_mutex, std::int32_t y, std::int32_t p, bool forwards, std::vector<std::uint64_t> &times, const Theme &theme, TextBuffer &buf, const TextLayout &layout, const Scorer &scorer, const std::atomic_uint32_t &epoch, std::uint32_t seen, DirectTerminal *direct, Compositor &compositor) {
+    const std::uint64_t rdcaret_wait = settings().caret_wait;
+    if (settings().smooth_caret) {
+        /* 15 sub-frames per move, never slower than the last keystroke interval */
+        std::uint64_t frame_us = rdcaret_wait;
+        {
+            std::lock_guard guard(term_mutex);
+            if (times.size() > 1) {
+                frame_us = std::min<std::uint64_t>(rdcaret_wait, (times[times.size() - 1] - times[times.size() - 2]) / 15'000);
+            }
+        }
+
+        auto next_frame = std::chrono::steady_clock::now();
+        auto frame = [&](std::int32_t at, std::int16_t pair, std::uint32_t index) -> bool {
+            if (epoch != seen) { return false; }
+            {
+                std::lock_guard guard(term_mutex);
+                const auto [row, col] = layout.position(buf, at);
+                if (direct != nullptr) {
+                    direct->put_caret(y + row, col, index, pair == theme.caret_inverse_pair);
+                } else {
+                    compositor.set_cursor_visible(false);
+                    move(y + row, col);
+                    nccon(pair);
+                    printw("%lc", get_unicode_caret(index));
+                    nccoff(pair);
+                    move(y + row, col);
+                }
+            }
+            compositor.invalidate();
+            next_frame += std::chrono::microseconds(frame_us);
+            std::this_thread::sleep_until(next_frame);
+            return true;
+        };
+
+        bool complete = true;
+        if (p > 0 && forwards) {
+            for (std::uint32_t i = 0; i < 8 && complete; i++) {
+                complete = frame(p - 1, theme.caret_pair, i);
+            }
+            for (std::uint32_t i = 0; i < 7 && complete; i++) {
+                complete = frame(p - 1, theme.caret_inverse_pair, i);
+            }
+        } else if (!forwards) {
+            for (std::int32_t i = 7; i >= 0 && complete; i--) {
+                complete = frame(p, theme.caret_inverse_pair, i);
+            }
+            for (std::int32_t i = 7; i >= 1 && complete; i--) {
+                complete = frame(p, theme.caret_pair, i);
+            }
+        }
+
+        std::lock_guard guard(term_mutex);
+        const std::int32_t ep = p + (static_cast<std::int32_t>(!forwards) - 1);
+        const bool underline = buf[ep].ch != ' ' && scorer.underlined(buf[ep].word);
+        const auto [ep_row, ep_col] = layout.position(buf, ep);
+
+        if (direct != nullptr) {
+            direct->put(y + ep_row, ep_col, buf[ep].ch, buf[ep].state, underline);
+        } else {
+            compositor.set_cursor_visible(false);
+            if (underline) {
+                attron(A_UNDERLINE);
+            }
+            move(y + ep_row, ep_col);
+            outch(buf[ep], theme);
+            if (underline) {
+                attroff(A_UNDERLINE);
+            }
+        }
+        /* the next move is already on its way and will place the caret */
+        if (!complete) {
+            compositor.invalidate();
+            return;
+        }
+    }
+
+    std::lock_guard guard(term_mutex);
+    compositor.invalidate();
+    const auto [row, col] = layout.position(buf, p);
+    const auto [before_row, before_col] = layout.position(buf, std::max(p, 1) - 1);
+    if (direct != nullptr) {
+        if (settings().xterm_support) {
+            direct->show_cursor(y + row, col);
+            compositor.set_cursor_shape(CursorType::steady_bar_xterm);
+        } else if (p > 0) {
+            direct->put_caret(y + before_row, before_col, 8, false);
+        }
+        return;
+    }
+    if (settings().xterm_support) {
+        compositor.set_cursor_visible(true);
+        move(y + row, col);
+        compositor.set_cursor_shape(CursorType::steady_bar_xterm);
+    } else {
+        compositor.set_cursor_visible(false);
+        nccon(theme.caret_pair);
+        if (p > 0) {
+            mvprintw(y + before_row, before_col, "%lc", get_unicode_caret(8));
+        }
+        nccoff(theme.caret_pair);
+    }
+}
+
+
+std::string get_file_content(const std::string &filename) {
+    std::ifstream file(filename);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    std::string text = ss.str();
+    file.close();
+    return text;
+}
+
+/* read only mapping of a whole file, closed when the file can't be opened or is empty */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string &filename) {
+        const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { return; }
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *mapped = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped != MAP_FAILED) {
+                addr = mapped;
+                len = static_cast<std::size_t>(st.st_size);
+            }
+        }
+        close(fd); /* the mapping keeps its own reference */
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept : addr(std::exchange(other.addr, nullptr)), len(std::exchange(other.len, 0)) {}
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            unmap();
+            addr = std::exchange(other.addr, nullptr);
+            len = std::exchange(other.len, 0);
+        }
+        return *this;
+    }
+
+    ~MappedFile() { unmap(); }
+
+    [[nodiscard]] const char *data() const { return static_cast<const char *>(addr); }
+    [[nodiscard]] std::size_t size() const { return len; }
+    [[nodiscard]] bool is_open() const { return addr != nullptr; }
+
+private:
+    void unmap() {
+        if (addr != nullptr) { munmap(addr, len); }
+        addr = nullptr;
+        len = 0;
+    }
+
+    void *addr = nullptr;
+    std::size_t len = 0;
+};
+
+/* identifies the version of a source file a compiled cache was built from */
+struct SourceStamp {
+    std::uint64_t size = 0;
+    std::int64_t mtime_ns = 0;
+
+    bool operator==(const SourceStamp &) const = default;
+};
+
+SourceStamp source_stamp(const std::string &filename) {
+    struct stat st{};
+    if (stat(filename.c_str(), &st) != 0) { return {}; }
+    return SourceStamp{.size = static_cast<std::uint64_t>(st.st_size), .mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * std::nano::den + st.st_mtim.tv_nsec};
+}
+
+/* common prefix of every compiled cache file */
+struct CacheHeader {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t count;
+    SourceStamp source;
+};
+
+/* writes to a temporary next to filename and renames over it, so readers never see a partial file */
+bool write_file_atomic(const std::string &filename, std::string_view contents) {
+    const std::string tmp_filename = filename + ".tmp";
+    {
+        std::ofstream outfile(tmp_filename, std::ios::binary | std::ios::trunc);
+        outfile.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!outfile) { return false; }
+    }
+    return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+/* rapidjson input stream over gzread, which reads uncompressed files as they are, so plain and .gz assets parse alike */
+class GzReadStream {
+public:
+    using Ch = char;
+
+    explicit GzReadStream(gzFile file) : file(file) { read(); }
+
+    [[nodiscard]] Ch Peek() const { return *current; }
+    Ch Take() {
+        const Ch c = *current;
+        read();
+        return c;
+    }
+    [[nodiscard]] std::size_t Tell() const { return count + static_cast<std::size_t>(current - buffer.data()); }
+
+    /* not an output stream */
+    Ch *PutBegin() { return nullptr; }
+    void Put(Ch) {}
+    void Flush() {}
+    std::size_t PutEnd(Ch *) { return 0; }
+
+private:
+    /* same buffering as rapidjson::FileReadStream, a '\0' after the last byte ends the input */
+    void read() {
+        if (current < last) {
+            current++;
+        } else if (!eof) {
+            count += read_count;
+            const int got = gzread(file, buffer.data(), static_cast<unsigned>(buffer.size() - 1));
+            read_count = got > 0 ? static_cast<std::size_t>(got) : 0;
+            current = buffer.data();
+            last = buffer.data() + read_count - 1;
+            if (read_count < buffer.size() - 1) {
+                buffer[read_count] = '\0';
+                last++;
+                eof = true;
+            }
+        }
+    }
+
+    gzFile file;
+    std::array<Ch, 65536> buffer{};
+    Ch *current = buffer.data(), *last = nullptr;
+    std::size_t read_count = 0, count = 0;
+    bool eof = false;
+};
+
+/* gzip wrapped deflate into a file, fed a chunk at a time so the whole input is never held in memory */
+class GzipWriter {
+public:
+    GzipWriter() = default;
+    GzipWriter(const GzipWriter &) = delete;
+    GzipWriter &operator=(const GzipWriter &) = delete;
+    ~GzipWriter() {
+        if (started) { deflateEnd(&zs); }
+    }
+
+    bool open(const std::string &filename) {
+        out.open(filename, std::ios::binary | std::ios::trunc);
+        started = out && deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        return started;
+    }
+
+    [[nodiscard]] bool is_open() const { return started; }
+
+    bool write(const char *data, std::size_t length) { return pump(data, length, Z_NO_FLUSH); }
+
+    /* writes the gzip trailer and closes the file */
+    bool finish() {
+        const bool done = pump(nullptr, 0, Z_FINISH);
+        out.close();
+        return done && static_cast<bool>(out);
+    }
+
+private:
+    bool pump(const char *data, std::size_t length, int flush) {
+        if (!started) { return false; }
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        zs.avail_in = static_cast<uInt>(length);
+        int status = Z_OK;
+        do {
+            zs.next_out = reinterpret_cast<Bytef *>(chunk.data());
+            zs.avail_out = static_cast<uInt>(chunk.size());
+            status = deflate(&zs, flush);
+            if (status == Z_STREAM_ERROR) { return false; }
+            out.write(chunk.data(), static_cast<std::streamsize>(chunk.size() - zs.avail_out));
+        } while (zs.avail_out == 0);
+        return static_cast<bool>(out) && (flush != Z_FINISH || status == Z_STREAM_END);
+    }
+
+    z_stream zs{};
+    bool started = false;
+    std::ofstream out;
+    std::vector<char> chunk = std::vector<char>(1 << 16);
+};
+
+/* read a chunk at a time, so hashing a big asset costs no more memory than a small one */
+std::string sha256_file(const std::string &filename) {
+    std::ifstream in(filename, std::ios::binary);
+    std::vector<char> chunk(1 << 16);
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+    while (in.read(chunk.data(), static_cast<std::streamsize>(chunk.size())) || in.gcount() > 0) {
+        EVP_DigestUpdate(ctx, chunk.data(), static_cast<std::size_t>(in.gcount()));
+    }
+    std::array<unsigned char, EVP_MAX_MD_SIZE> digest{};
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(ctx, digest.data(), &length);
+    EVP_MD_CTX_free(ctx);
+
+    static constexpr std::string_view hex = "0123456789abcdef";
+    std::string out;
+    for (unsigned int i = 0; i < length; i++) {
+        out.push_back(hex[digest[i] >> 4]);
+        out.push_back(hex[digest[i] & 15]);
+    }
+    return out;
+}
+
+/* <file>.meta next to every downloaded asset, key=value lines like main.conf */
+struct AssetMeta {
+    std::string etag, last_modified, sha256;
+    std::uint64_t size = 0;
+    std::int64_t checked = 0; /* unix seconds of the last successful 200 or 304 */
+
+    static std::optional<AssetMeta> load(const std::string &filename) {
+        if (!file_exists(filename)) { return std::nullopt; }
+        std::vector<std::string> lines;
+        split(get_file_content(filename), "\n", lines);
+        AssetMeta meta;
+        for (const std::string &line : lines) {
+            const std::size_t eq = line.find('=');
+            if (eq == std::string::npos) { continue; }
+            const std::string key = line.substr(0, eq), value = line.substr(eq + 1);
+            if (key == "etag") { meta.etag = value; }
+            else if (key == "last_modified") { meta.last_modified = value; }
+            else if (key == "sha256") { meta.sha256 = value; }
+            else if (key == "size") { meta.size = std::strtoull(value.c_str(), nullptr, 10); }
+            else if (key == "checked") { meta.checked = std::strtoll(value.c_str(), nullptr, 10); }
+        }
+        return meta;
+    }
+
+    [[nodiscard]] bool save(const std::string &filename) const {
+        return write_file_atomic(filename, "etag=" + etag + "\nlast_modified=" + last_modified + "\nsize=" + std::to_string(size)
+            + "\nsha256=" + sha256 + "\nchecked=" + std::to_string(checked) + '\n');
+    }
+};
+
+/* custom mode: a file of the user's own, mapped whole and read a page at a time, so opening even a huge one costs nothing */
+/* and only the pages around the current offset are ever resident; the file is never copied or compiled */
+/* whitespace runs turn into one space and anything that can't be typed is dropped, as each page is read */
+class CustomText {
+public:
+    bool open(const std::string &filename) {
+        file = MappedFile(filename);
+        name = filename;
+        stamp = source_stamp(filename);
+        if (file.is_open()) { madvise(const_cast<char *>(file.data()), file.size(), MADV_SEQUENTIAL); }
+        return file.is_open();
+    }
+
+    [[nodiscard]] bool is_open() const { return file.is_open(); }
+    [[nodiscard]] const std::string &filename() const { return name; }
+    [[nodiscard]] const SourceStamp &source() const { return stamp; }
+    [[nodiscard]] std::size_t size() const { return file.size(); }
+
+    /* appends about chars chars of text starting at byte offset, ending on a word, returns the byte offset to continue from */
+    std::size_t page(std::size_t offset, std::size_t chars, std::string &out) const {
+        const char *data = file.data();
+        const std::size_t size = file.size();
+        const std::size_t begin = out.size();
+        bool space = false;
+        auto emit = [&](std::string_view s) {
+            if (space && out.size() > begin) { out.push_back(' '); }
+            space = false;
+            out.append(s);
+        };
+
+        std::size_t i = offset;
+        while (i < size) {
+            const auto c = static_cast<unsigned char>(data[i]);
+            const std::size_t written = out.size() - begin;
+            if (c == ' ' || (c >= '\t' && c <= '\r')) {
+                if (written >= chars) { break; }
+                space = true;
+                i++;
+            } else if (c > ' ' && c < 0x7F) {
+                if (written >= chars * 2) { break; } /* one enormous word, cut it */
+                emit(std::string_view(data + i, 1));
+                i++;
+            } else if (c >= 0xC0) {
+                /* utf-8: the punctuation word processors like to swap in has a plain keyboard spelling, the rest is dropped */
+                std::size_t len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+                len = std::min(len, size - i);
+                const std::string_view seq(data + i, len);
+                if (seq == "\xC2\xA0" || seq == "\xE2\x80\xA8" || seq == "\xE2\x80\xA9") {
+                    if (written >= chars) { break; }
+                    space = true;
+                } else if (seq.starts_with("\xE2\x80") && len == 3) {
+                    const auto d = static_cast<unsigned char>(seq[2]);
+                    if (d >= 0x98 && d <= 0x9B) {
+                        emit("'");
+                    } else if (d >= 0x9C && d <= 0x9F) {
+                        emit("\"");
+                    } else if (d >= 0x90 && d <= 0x95) {
+                        emit("-");
+                    } else if (d == 0xA6) {
+                        emit("...");
+                    }
+                }
+                i += len;
+            } else {
+                i++; /* control chars and stray continuation bytes */
+            }
+        }
+        return i;
+    }
+
+    /* done with everything before offset, its pages can go */
+    void release_before(std::size_t offset) {
+        const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t end = std::min(offset, file.size()) / page_size * page_size;
+        if (end > 0) { madvise(const_cast<char *>(file.data()), end, MADV_DONTNEED); }
+    }
+
+private:
+    MappedFile file;
+    std::string name;
+    SourceStamp stamp;
+};
+
+/* where custom mode left off, only for the file it was last used with */
+struct CustomProgress {
+    std::string filename;
+    SourceStamp source;
+    std::uint64_t offset = 0;
+
+    static CustomProgress load(const std::string &progress_filename) {
+        CustomProgress progress;
+        if (!file_exists(progress_filename)) { return progress; }
+        std::vector<std::string> lines;
+        split(get_file_content(progress_filename), "\n", lines);
+        for (const std::string &line : lines) {
+            const std::size_t eq = line.find('=');
+            if (eq == std::string::npos) { continue; }
+            const std::string key = line.substr(0, eq), value = line.substr(eq + 1);
+            if (key == "file") { progress.filename = value; }
+            else if (key == "size") { progress.source.size = std::strtoull(value.c_str(), nullptr, 10); }
+            else if (key == "mtime_ns") { progress.source.mtime_ns = std::strtoll(value.c_str(), nullptr, 10); }
+            else if (key == "offset") { progress.offset = std::strtoull(value.c_str(), nullptr, 10); }
+        }
+        return progress;
+    }
+
+    bool save(const std::string &progress_filename) const {
+        return write_file_atomic(progress_filename, "file=" + filename + "\nsize=" + std::to_string(source.size)
+            + "\nmtime_ns=" + std::to_string(source.mtime_ns) + "\noffset=" + std::to_string(offset) + '\n');
+    }
+};
+
+std::int64_t unix_seconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/* downloads assets from asset_host on a few worker threads, each keeping one keep-alive connection per host */
+/* a file is fetched at most once, everyone asking for it shares the same future */
+/* downloads get a .meta sidecar and are revalidated with a conditional GET once revalidate_after has passed, */
+/* a file on disk without a sidecar was put there by hand and is left alone */
+class AssetFetcher {
+public:
+    static constexpr std::size_t worker_count = 4;
+    static constexpr std::int64_t revalidate_after = 24 * 60 * 60; /* seconds */
+
+    explicit AssetFetcher(std::size_t workers_wanted = worker_count) {
+        for (std::size_t i = 0; i < workers_wanted; i++) {
+            workers.emplace_back([this](std::stop_token stoken) { work(stoken); });
+        }
+    }
+
+    /* language and quote lists are big and only ever streamed, so they are kept gzipped; the _list.json manifests are not */
+    static bool compressed(const std::string &filename) {
+        return (filename.starts_with("languages/") || filename.starts_with("quotes/")) && !filename.ends_with("/_list.json");
+    }
+
+    /* where filename lives on disk, a plain copy wins over the compressed one */
+    static std::string local_path(const std::string &filename) {
+        if (!compressed(filename) || file_exists(filename)) { return filename; }
+        return filename + ".gz";
+    }
+
+    /* the future holds an error message, empty on success */
+    std::shared_future<std::string> prefetch(const std::string &filename) {
+        std::lock_guard guard(mutex);
+        if (auto it = fetches.find(filename); it != fetches.end()) { return it->second; }
+        /* offline never touches the network, whatever was mirrored is used as is */
+        if (up_to_date(local_path(filename)) || settings().offline) {
+            std::promise<std::string> done;
+            done.set_value(file_exists(local_path(filename)) ? "" : "offline, run simian --mirror while online");
+            return fetches.emplace(filename, done.get_future().share()).first->second;
+        }
+        Job job{.filename = filename, .host = settings().asset_host, .insecure_tls = settings().insecure_tls, .result = std::promise<std::string>()};
+        std::shared_future<std::string> result = job.result.get_future().share();
+        jobs.push_back(std::move(job));
+        ready.notify_one();
+        return fetches.emplace(filename, result).first->second;
+    }
+
+    /* blocks until filename is on disk and returns its local path, origin is where it is called from for errors */
+    std::string await(const std::string &filename, const std::string &origin) {
+        std::shared_future<std::string> result = prefetch(filename);
+        if (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            printw("info: %s: fetching %s/%s\n", origin.c_str(), settings().asset_host.c_str(), filename.c_str());
+            refresh();
+        }
+        const std::string &error = result.get();
+        if (!error.empty()) {
+            deinit_ncurses();
+            std::cerr << "fatal: " << origin << ": fetch for " << filename << " failed with " << error << '\n';
+            exit(1);
+        }
+        return local_path(filename);
+    }
+
+private:
+    /* everything a worker needs from settings is copied in here, the snapshot may be rebuilt while it downloads */
+    struct Job {
+        std::string filename, host;
+        bool insecure_tls = false;
+        std::promise<std::string> result;
+    };
+
+    /* only a stat, hashes are checked when revalidating */
+    static bool up_to_date(const std::string &local) {
+        if (!file_exists(local)) { return false; }
+        const std::optional<AssetMeta> meta = AssetMeta::load(local + ".meta");
+        if (!meta.has_value()) { return true; }
+        return std::filesystem::file_size(local) == meta->size && unix_seconds() - meta->checked < revalidate_after;
+    }
+
+    void work(const std::stop_token &stoken) {
+        std::unordered_map<std::string, std::unique_ptr<httplib::Client>> clients;
+        while (true) {
+            Job job;
+            {
+                std::unique_lock guard(mutex);
+                if (!ready.wait(guard, stoken, [&]() { return !jobs.empty(); })) { return; }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            std::unique_ptr<httplib::Client> &cli = clients[job.host];
+            if (!cli) {
+                cli = std::make_unique<httplib::Client>(job.host);
+                cli->set_keep_alive(true);
+                cli->set_decompress(true);
+                cli->set_connection_timeout(5);
+                cli->set_read_timeout(15);
+                /* only for a self signed stand-in host, asked for by name in main.conf */
+                if (job.insecure_tls) { cli->enable_server_certificate_verification(false); }
+            }
+            job.result.set_value(download(*cli, job.filename));
+        }
+    }
+
+    /* the identity body is streamed into <filename>.part, which a later attempt resumes with a Range request guarded by If-Range */
+    /* on the validators the first response came with, kept in <filename>.part.meta; assets stored compressed are deflated */
+    /* into <local>.part as the bytes arrive, a resumed one replays what .part already has through the deflater first */
+    static std::string download(httplib::Client &cli, const std::string &filename) {
+        const std::string local = local_path(filename);
+        const std::string meta_filename = local + ".meta";
+        const std::string part_filename = filename + ".part";
+        const std::string part_meta_filename = part_filename + ".meta";
+        const bool pack = compressed(filename) && local != filename;
+        const std::string packed_filename = local + ".part";
+        std::optional<AssetMeta> meta = AssetMeta::load(meta_filename);
+        const bool have_local = file_exists(local);
+
+        std::error_code ec;
+        /* a weak etag can't be used with If-Range, without any validator a partial file can't be resumed safely */
+        std::string if_range;
+        const std::optional<AssetMeta> part_meta = AssetMeta::load(part_meta_filename);
+        if (part_meta.has_value()) {
+            if_range = !part_meta->etag.empty() && !part_meta->etag.starts_with("W/") ? part_meta->etag : part_meta->last_modified;
+        }
+        if (if_range.empty()) { std::filesystem::remove(part_filename, ec); }
+        const std::uint64_t resume_from = file_exists(part_filename) ? std::filesystem::file_size(part_filename) : 0;
+
+        httplib::Headers headers;
+        if (resume_from > 0) {
+            headers.emplace("Range", "bytes=" + std::to_string(resume_from) + "-");
+            headers.emplace("If-Range", if_range);
+        } else {
+            headers.emplace("Accept-Encoding", "gzip");
+            /* validators are only sent for a local copy that still matches its sidecar, anything else is fetched whole */
+            if (have_local && meta.has_value() && sha256_file(local) == meta->sha256) {
+                if (!meta->etag.empty()) { headers.emplace("If-None-Match", meta->etag); }
+                if (!meta->last_modified.empty()) { headers.emplace("If-Modified-Since", meta->last_modified); }
+            }
+        }
+
+        std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), ec);
+        std::ofstream part;
+        GzipWriter packed;
+        auto resp = cli.Get("/" + filename, headers,
+            [&](const httplib::Response &r) {
+                if (r.status == 200) {
+                    /* a 200 to a Range request means the resource changed, what .part had is thrown away */
+                    part.open(part_filename, std::ios::binary | std::ios::trunc);
+                    const AssetMeta validators{.etag = r.get_header_value("ETag"), .last_modified = r.get_header_value("Last-Modified"), .sha256 = "", .size = 0, .checked = 0};
+                    if (!validators.save(part_meta_filename)) { return false; }
+                    if (pack && !packed.open(packed_filename)) { return false; }
+                }
+                if (r.status == 206) {
+                    if (pack) {
+                        if (!packed.open(packed_filename)) { return false; }
+                        std::ifstream previous(part_filename, std::ios::binary);
+                        std::vector<char> chunk(1 << 16);
+                        while (previous.read(chunk.data(), static_cast<std::streamsize>(chunk.size())) || previous.gcount() > 0) {
+                            if (!packed.write(chunk.data(), static_cast<std::size_t>(previous.gcount()))) { return false; }
+                        }
+                    }
+                    part.open(part_filename, std::ios::binary | std::ios::app);
+                }
+                return true;
+            },
+            [&](const char *data, std::size_t length) {
+                if (!part.is_open()) { return true; } /* error pages are not kept */
+                part.write(data, static_cast<std::streamsize>(length));
+                if (packed.is_open() && !packed.write(data, length)) { return false; }
+                return static_cast<bool>(part);
+            });
+        part.close();
+
+        if (!resp) {
+            if (have_local) { return ""; } /* offline, the old copy is still good */
+            std::stringstream s;
+            s << "httplib error " << resp.error();
+            return s.str();
+        }
+        if (resp->status == 304 && meta.has_value()) {
+            meta->checked = unix_seconds();
+            return meta->save(meta_filename) ? "" : "could not write " + meta_filename;
+        }
+        if (resp->status == 416) { /* the partial file is not a prefix of what the server has now */
+            std::filesystem::remove(part_filename, ec);
+            std::filesystem::remove(part_meta_filename, ec);
+        }
+        if (resp->status != 200 && resp->status != 206) {
+            if (have_local) { return ""; }
+            return "status " + std::to_string(resp->status);
+        }
+
+        /* a gzip transfer carries the compressed length, its own trailer checks the size instead */
+        std::uint64_t expected = 0;
+        if (resp->status == 206) {
+            const std::string range = resp->get_header_value("Content-Range");
+            const std::size_t slash = range.rfind('/');
+            if (slash != std::string::npos) { expected = std::strtoull(range.c_str() + slash + 1, nullptr, 10); }
+        } else if (!resp->has_header("Content-Encoding") && resp->has_header("Content-Length")) {
+            expected = std::strtoull(resp->get_header_value("Content-Length").c_str(), nullptr, 10);
+        }
+        const std::uint64_t got = std::filesystem::file_size(part_filename, ec);
+        if (expected != 0 && got != expected) {
+            if (got > expected) { std::filesystem::remove(part_filename, ec); }
+            return "size mismatch, have " + std::to_string(got) + " of " + std::to_string(expected) + " bytes";
+        }
+
+        std::array<char, 9> head{};
+        std::ifstream(part_filename, std::ios::binary).read(head.data(), head.size());
+        if (std::string_view(head.data(), head.size()) == "<!doctype") { /* returned nice looking html 404 page */
+            std::filesystem::remove(part_filename, ec);
+            std::filesystem::remove(part_meta_filename, ec);
+            if (have_local) { return ""; }
+            return "status 400";
+        }
+
+        /* data first, so a crash in between leaves a sidecar whose size no longer matches and the file is fetched again */
+        if (pack) {
+            if (!packed.finish()) { return "gzip error"; }
+            if (std::rename(packed_filename.c_str(), local.c_str()) != 0) { return "could not write " + local; }
+            std::filesystem::remove(part_filename, ec);
+        } else if (std::rename(part_filename.c_str(), local.c_str()) != 0) {
+            return "could not write " + local;
+        }
+        std::filesystem::remove(part_meta_filename, ec);
+        /* a 206 need not repeat the validators, the ones the transfer started with still hold */
+        const bool resumed = resp->status == 206 && part_meta.has_value();
+        AssetMeta fresh{
+            .etag = resp->has_header("ETag") || !resumed ? resp->get_header_value("ETag") : part_meta->etag,
+            .last_modified = resp->has_header("Last-Modified") || !resumed ? resp->get_header_value("Last-Modified") : part_meta->last_modified,
+            .sha256 = sha256_file(local), .size = std::filesystem::file_size(local, ec), .checked = unix_seconds()
+        };
+        return fresh.save(meta_filename) ? "" : "could not write " + meta_filename;
+    }
+
+    std::mutex mutex;
+    std::condition_variable_any ready;
+    std::deque<Job> jobs;
+    std::unordered_map<std::string, std::shared_future<std::string>> fetches;
+    std::vector<std::jthread> workers; /* last, so they stop before the rest is destroyed */
+};
+
+/* started on first use, so command line tools that never fetch spawn no threads */
+AssetFetcher &assets() {
+    static AssetFetcher fetcher;
+    return fetcher;
+}
+
+/* will fetch from asset_host if not exist locally, returns the path to read it from */
+/* filename should not have beginning */
+/* origin is where it is called from for errors */
+std::string fetch_file(const std::string &filename, const std::string &origin) {
+    return assets().await(filename, origin);
+}
+
+/* like fetch_file, but a copy already on disk is used right away and only revalidated in the background */
+std::string fetch_file_cached(const std::string &filename, const std::string &origin) {
+    const std::string local = AssetFetcher::local_path(filename);
+    if (!file_exists(local)) { return fetch_file(filename, origin); }
+    assets().prefetch(filename);
+    return local;
+}
+
+template <typename T>
+void append_raw(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/* maps the cache for header type H if it was built from source, checking magic, version and size of the fixed part */
+template <typename H>
+std::optional<MappedFile> open_cache(const std::string &cache_filename, const std::array<char, 8> &magic, std::uint32_t version, const SourceStamp &source) {
+    MappedFile file(cache_filename);
+    if (!file.is_open() || file.size() < sizeof(H)) { return std::nullopt; }
+    const auto *header = reinterpret_cast<const CacheHeader *>(file.data());
+    if (header->magic != magic || header->version != version || header->source != source) { return std::nullopt; }
+    return file;
+}
+
+
+/* languages/<lang>.json compiled to languages/<lang>.bin: */
+/* CacheHeader, blob size, count + 1 uint32 offsets into the blob, then the blob with every word back to back */
+class WordList {
+public:
+    static constexpr std::array<char, 8> magic = {'s', 'i', 'm', 'w', 'o', 'r', 'd', 's'};
+    static constexpr std::uint32_t version = 1;
+
+    struct Header {
+        CacheHeader base;
+        std::uint64_t blob_size;
+    };
+
+    [[nodiscard]] std::size_t size() const { return count; }
+    [[nodiscard]] bool empty() const { return count == 0; }
+
+    [[nodiscard]] std::string_view operator[](std::size_t i) const {
+        return {blob + offsets[i], offsets[i + 1] - offsets[i]};
+    }
+
+    /* false if the mapping is not a well formed cache for source */
+    bool open(const std::string &cache_filename, const SourceStamp &source) {
+        std::optional<MappedFile> mapped = open_cache<Header>(cache_filename, magic, version, source);
+        if (!mapped.has_value()) { return false; }
+        const auto *header = reinterpret_cast<const Header *>(mapped->data());
+        const std::size_t want = sizeof(Header) + (header->base.count + 1ULL) * sizeof(std::uint32_t) + header->blob_size;
+        if (mapped->size() != want) { return false; }
+
+        file = std::move(mapped.value());
+        count = header->base.count;
+        offsets = reinterpret_cast<const std::uint32_t *>(file.data() + sizeof(Header));
+        blob = file.data() + sizeof(Header) + (count + 1ULL) * sizeof(std::uint32_t);
+        return true;
+    }
+
+    static bool compile(const std::string &json_filename, const std::string &cache_filename) {
+        gzFile pfile = gzopen(json_filename.c_str(), "rb");
+        if (pfile == nullptr) { return false; }
+        rapidjson::Document doc;
+        GzReadStream grs(pfile);
+        doc.ParseStream(grs);
+        gzclose(pfile);
+        if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("words") || !doc["words"].IsArray()) { return false; }
+
+        std::vector<std::uint32_t> word_offsets = {0};
+        std::string word_blob;
+        for (const auto &word : doc["words"].GetArray()) {
+            word_blob.append(word.GetString(), word.GetStringLength());
+            word_offsets.push_back(static_cast<std::uint32_t>(word_blob.size()));
+        }
+
+        Header header{};
+        header.base = CacheHeader{.magic = magic, .version = version, .count = static_cast<std::uint32_t>(word_offsets.size() - 1), .source = source_stamp(json_filename)};
+        header.blob_size = word_blob.size();
+
+        std::string out;
+        out.reserve(sizeof(Header) + word_offsets.size() * sizeof(std::uint32_t) + word_blob.size());
+        append_raw(out, header);
+        out.append(reinterpret_cast<const char *>(word_offsets.data()), word_offsets.size() * sizeof(std::uint32_t));
+        out.append(word_blob);
+        return write_file_atomic(cache_filename, out);
+    }
+
+private:
+    MappedFile file;
+    std::size_t count = 0;
+    const std::uint32_t *offsets = nullptr;
+    const char *blob = nullptr;
+};
+
+/* rebuilds languages/<lang>.bin whenever the json next to it changed */
+void get_words(WordList &outs) {
+    const std::string words_filename = fetch_file("languages/" + settings().language + ".json", "get_words");
+    const std::string cache_filename = "languages/" + settings().language + ".bin";
+    const SourceStamp stamp = source_stamp(words_filename);
+    if (outs.open(cache_filename, stamp)) { return; }
+
+    if (!WordList::compile(words_filename, cache_filename) || !outs.open(cache_filename, stamp)) {
+        deinit_ncurses();
+        std::cerr << "fatal: get_words: failed to compile " << words_filename << " into " << cache_filename << '\n';
+        exit(1);
+    }
+}
+
+
+/* per key and per bigram hit, error and latency counters over printable ascii, kept across sessions in keystats.bin */
+/* a bigram is (previous expected char, expected char), so it tracks the transition the fingers had to make */
+class KeyStats {
+public:
+    static constexpr std::array<char, 8> magic = {'s', 'i', 'm', 'k', 'e', 'y', 's', ' '};
+    static constexpr std::uint32_t version = 1;
+    static constexpr std::uint32_t first = 32, keys = 95;
+    static constexpr std::uint32_t bigrams = keys * keys;
+
+    struct Counter {
+        std::uint32_t hits = 0, errors = 0;
+        std::uint64_t latency_us = 0;
+    };
+
+    static bool printable(char c) { return static_cast<unsigned char>(c) >= first && static_cast<unsigned char>(c) < first + keys; }
+
+    /* caller checks both chars are printable */
+    static std::uint32_t bigram_id(char a, char b) { return (static_cast<unsigned char>(a) - first) * keys + (static_cast<unsigned char>(b) - first); }
+
+    void record(char prev, char expected, bool hit, std::uint64_t latency_ns) {
+        if (!printable(expected)) { return; }
+        const std::uint64_t latency_us = std::min<std::uint64_t>(latency_ns / 1000, 2'000'000); /* pauses longer than 2s are not latency */
+        bump(key_counters[static_cast<unsigned char>(expected) - first], hit, latency_us);
+        if (printable(prev)) {
+            bump(bigram_counters[bigram_id(prev, expected)], hit, latency_us);
+        }
+    }
+
+    [[nodiscard]] const Counter &bigram(std::uint32_t id) const { return bigram_counters[id]; }
+
+    /* smoothed error rate scaled up by how slow the transition is compared to the average, only bigrams seen at least min_hits times */
+    [[nodiscard]] std::vector<std::pair<std::uint32_t, double>> worst(std::size_t n, std::uint32_t min_hits) const {
+        std::uint64_t hits = 0, latency = 0;
+        for (const Counter &c : key_counters) {
+            hits += c.hits;
+            latency += c.latency_us;
+        }
+        const double mean_latency = hits == 0 ? 1.0 : static_cast<double>(latency) / static_cast<double>(hits);
+
+        std::vector<std::pair<std::uint32_t, double>> scored;
+        for (std::uint32_t id = 0; id < bigrams; id++) {
+            const Counter &c = bigram_counters[id];
+            if (c.hits < min_hits) { continue; }
+            const double error_rate = (static_cast<double>(c.errors) + 1.0) / (static_cast<double>(c.hits) + 2.0);
+            const double slowness = static_cast<double>(c.latency_us) / static_cast<double>(c.hits) / mean_latency;
+            scored.emplace_back(id, error_rate * std::max(0.5, slowness));
+        }
+        const std::size_t keep = std::min(n, scored.size());
+        std::partial_sort(scored.begin(), scored.begin() + static_cast<std::ptrdiff_t>(keep), scored.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+        scored.resize(keep);
+        return scored;
+    }
+
+    void load(const std::string &filename) {
+        MappedFile file(filename);
+        const std::size_t want = magic.size() + sizeof(version) + sizeof(key_counters) + sizeof(bigram_counters);
+        if (file.size() != want || !std::equal(magic.begin(), magic.end(), file.data())) { return; }
+        std::uint32_t file_version = 0;
+        std::memcpy(&file_version, file.data() + magic.size(), sizeof(file_version));
+        if (file_version != version) { return; }
+        const char *at = file.data() + magic.size() + sizeof(version);
+        std::memcpy(key_counters.data(), at, sizeof(key_counters));
+        std::memcpy(bigram_counters.data(), at + sizeof(key_counters), sizeof(bigram_counters));
+    }
+
+    void save(const std::string &filename) const {
+        std::string out(magic.data(), magic.size());
+        append_raw(out, version);
+        append_raw(out, key_counters);
+        append_raw(out, bigram_counters);
+        write_file_atomic(filename, out);
+    }
+
+private:
+    static void bump(Counter &c, bool hit, std::uint64_t latency_us) {
+        c.hits++;
+        c.errors += static_cast<std::uint32_t>(!hit);
+        c.latency_us += latency_us;
+    }
+
+    std::array<Counter, keys> key_counters{};
+    std::array<Counter, bigrams> bigram_counters{};
+};
+
+/* languages/<lang>.bgi, the inverted index from bigram to the words containing it, cached next to languages/<lang>.bin: */
+/* CacheHeader, bigrams + 1 uint32 offsets into the postings, then the postings as word ids sorted by bigram */
+class BigramIndex {
+public:
+    static constexpr std::array<char, 8> magic = {'s', 'i', 'm', 'b', 'i', 'g', 'r', 'm'};
+    static constexpr std::uint32_t version = 1;
+
+    struct Header {
+        CacheHeader base;
+    };
+
+    [[nodiscard]] bool is_open() const { return offsets != nullptr; }
+
+    [[nodiscard]] std::span<const std::uint32_t> words_with(std::uint32_t bigram) const {
+        return {postings + offsets[bigram], postings + offsets[bigram + 1]};
+    }
+
+    bool open(const std::string &cache_filename, const SourceStamp &source) {
+        std::optional<MappedFile> mapped = open_cache<Header>(cache_filename, magic, version, source);
+        if (!mapped.has_value()) { return false; }
+        const auto *header = reinterpret_cast<const Header *>(mapped->data());
+        if (mapped->size() != sizeof(Header) + (KeyStats::bigrams + 1ULL + header->base.count) * sizeof(std::uint32_t)) { return false; }
+
+        file = std::move(mapped.value());
+        offsets = reinterpret_cast<const std::uint32_t *>(file.data() + sizeof(Header));
+        postings = offsets + KeyStats::bigrams + 1;
+        return true;
+    }
+
+    /* two passes over the list, counting then placing, so nothing but the output is allocated */
+    static bool compile(const WordList &words, const std::string &cache_filename, const SourceStamp &source) {
+        auto for_each_bigram = [&](std::uint32_t w, auto &&f) {
+            const std::string_view word = words[w];
+            std::bitset<KeyStats::bigrams> seen; /* a word is listed once per bigram */
+            for (std::size_t i = 1; i < word.size(); i++) {
+                if (!KeyStats::printable(word[i - 1]) || !KeyStats::printable(word[i])) { continue; }
+                const std::uint32_t id = KeyStats::bigram_id(word[i - 1], word[i]);
+                if (!seen[id]) {
+                    seen[id] = true;
+                    f(id);
+                }
+            }
+        };
+
+        std::vector<std::uint32_t> offsets_out(KeyStats::bigrams + 1, 0);
+        for (std::uint32_t w = 0; w < words.size(); w++) {
+            for_each_bigram(w, [&](std::uint32_t id) { offsets_out[id + 1]++; });
+        }
+        std::partial_sum(offsets_out.begin(), offsets_out.end(), offsets_out.begin());
+
+        std::vector<std::uint32_t> postings_out(offsets_out.back());
+        std::vector<std::uint32_t> fill(offsets_out.begin(), offsets_out.end() - 1);
+        for (std::uint32_t w = 0; w < words.size(); w++) {
+            for_each_bigram(w, [&](std::uint32_t id) { postings_out[fill[id]++] = w; });
+        }
+
+        Header header{};
+        header.base = CacheHeader{.magic = magic, .version = version, .count = static_cast<std::uint32_t>(postings_out.size()), .source = source};
+        std::string out;
+        out.reserve(sizeof(Header) + (offsets_out.size() + postings_out.size()) * sizeof(std::uint32_t));
+        append_raw(out, header);
+        out.append(reinterpret_cast<const char *>(offsets_out.data()), offsets_out.size() * sizeof(std::uint32_t));
+        out.append(reinterpret_cast<const char *>(postings_out.data()), postings_out.size() * sizeof(std::uint32_t));
+        return write_file_atomic(cache_filename, out);
+    }
+
+private:
+    MappedFile file;
+    const std::uint32_t *offsets = nullptr;
+    const std::uint32_t *postings = nullptr;
+};
+
+/* built once per word list, rebuilt together with languages/<lang>.bin */
+void get_bigram_index(const WordList &words, BigramIndex &outs) {
+    const std::string words_filename = AssetFetcher::local_path("languages/" + settings().language + ".json");
+    const std::string cache_filename = "languages/" + settings().language + ".bgi";
+    const SourceStamp stamp = source_stamp(words_filename);
+    if (outs.open(cache_filename, stamp)) { return; }
+
+    if (!BigramIndex::compile(words, cache_filename, stamp) || !outs.open(cache_filename, stamp)) {
+        deinit_ncurses();
+        std::cerr << "fatal: get_bigram_index: failed to build " << cache_filename << '\n';
+        exit(1);
+    }
+}
+
+
+/* xoshiro256** with splitmix64 seeding, https://prng.di.unimi.it */
+class Xoshiro256 {
+public:
+    using result_type = std::uint64_t;
+
+    explicit Xoshiro256(std::uint64_t seed) {
+        for (std::uint64_t &word : state) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            std::uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() {
+        const std::uint64_t result = std::rotl(state[1] * 5, 7) * 9;
+        const std::uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = std::rotl(state[3], 45);
+        return result;
+    }
+
+    /* in [0, n), multiply-shift instead of modulo, bias is negligible for word list sizes */
+    std::uint32_t below(std::uint32_t n) {
+        return static_cast<std::uint32_t>((static_cast<unsigned __int128>((*this)()) * n) >> 64);
+    }
+
+    double unit() {
+        return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+    }
+
+private:
+    std::array<std::uint64_t, 4> state{};
+};
+
+/* Vose's alias method: O(n) build, O(1) sample */
+class AliasTable {
+public:
+    void build(const std::vector<double> &weights) {
+        const std::size_t n = weights.size();
+        prob.assign(n, 0.0F);
+        alias.assign(n, 0);
+        if (n == 0) { return; }
+
+        const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+        std::vector<double> scaled(n);
+        std::vector<std::uint32_t> small, large;
+        for (std::size_t i = 0; i < n; i++) {
+            scaled[i] = weights[i] * static_cast<double>(n) / total;
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<std::uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            const std::uint32_t l = small.back(), g = large.back();
+            small.pop_back();
+            prob[l] = static_cast<float>(scaled[l]);
+            alias[l] = g;
+            scaled[g] = (scaled[g] + scaled[l]) - 1.0;
+            if (scaled[g] < 1.0) {
+                large.pop_back();
+                small.push_back(g);
+            }
+        }
+        for (const std::uint32_t i : large) { prob[i] = 1.0F; }
+        for (const std::uint32_t i : small) { prob[i] = 1.0F; } /* only left over from rounding */
+    }
+
+    [[nodiscard]] bool empty() const { return prob.empty(); }
+
+    std::uint32_t sample(Xoshiro256 &rng) const {
+        const std::uint32_t column = rng.below(static_cast<std::uint32_t>(prob.size()));
+        return rng.unit() < prob[column] ? column : alias[column];
+    }
+
+private:
+    std::vector<float> prob;
+    std::vector<std::uint32_t> alias;
+};
+
+/* draws words one at a time without touching the rest of the list, optionally weighted by frequency */
+/* monkeytype lists are ordered most common first, so frequency weighting is zipf over the rank */
+class WordGenerator {
+public:
+    WordGenerator(const WordList &words, bool frequency_weighted, std::uint64_t seed) : words(words), rng(seed) {
+        if (frequency_weighted && !words.empty()) {
+            std::vector<double> weights(words.size());
+            for (std::size_t i = 0; i < weights.size(); i++) {
+                weights[i] = 1.0 / static_cast<double>(i + 1);
+            }
+            table.build(weights);
+        }
+    }
+
+    [[nodiscard]] bool empty() const { return words.empty(); }
+
+    /* biases the following words towards the worst bigrams in stats, falls back to plain sampling until enough has been typed */
+    void use_weakness(const BigramIndex &index, const KeyStats &stats) {
+        weak_index = &index;
+        weak.clear();
+        weak_set.reset();
+        weak_total = 0.0;
+        for (const auto &[id, score] : stats.worst(weak_bigrams, 10)) {
+            if (index.words_with(id).empty()) { continue; }
+            weak.emplace_back(id, score);
+            weak_set[id] = true;
+            weak_total += score;
+        }
+    }
+
+    std::string_view next() {
+        if (!weak.empty()) { return words[next_weak()]; }
+        return words[table.empty() ? rng.below(static_cast<std::uint32_t>(words.size())) : table.sample(rng)];
+    }
+
+    /* appends k space separated words to out, with no trailing space */
+    void fill(std::string &out, std::size_t k) {
+        for (std::size_t i = 0; i < k && !empty(); i++) {
+            if (i > 0) { out.push_back(' '); }
+            out.append(next());
+        }
+    }
+
+private:
+    static constexpr std::size_t weak_bigrams = 8, weak_candidates = 4;
+
+    /* a weak bigram by score, then the densest in weak bigrams of a few words containing it */
+    std::uint32_t next_weak() {
+        double target = rng.unit() * weak_total;
+        std::uint32_t bigram = weak.back().first;
+        for (const auto &[id, score] : weak) {
+            if ((target -= score) <= 0.0) {
+                bigram = id;
+                break;
+            }
+        }
+
+        const std::span<const std::uint32_t> candidates = weak_index->words_with(bigram);
+        std::uint32_t best = candidates[rng.below(static_cast<std::uint32_t>(candidates.size()))];
+        double best_density = -1.0;
+        for (std::size_t c = 0; c < weak_candidates; c++) {
+            const std::uint32_t w = candidates[rng.below(static_cast<std::uint32_t>(candidates.size()))];
+            const std::string_view word = words[w];
+            std::uint32_t hits = 0;
+            for (std::size_t i = 1; i < word.size(); i++) {
+                hits += static_cast<std::uint32_t>(KeyStats::printable(word[i - 1]) && KeyStats::printable(word[i]) && weak_set[KeyStats::bigram_id(word[i - 1], word[i])]);
+            }
+            const double density = static_cast<double>(hits) / static_cast<double>(std::max<std::size_t>(word.size(), 1));
+            if (density > best_density) {
+                best_density = density;
+                best = w;
+            }
+        }
+        return best;
+    }
+
+    const WordList &words;
+    Xoshiro256 rng;
+    AliasTable table;
+
+    const BigramIndex *weak_index = nullptr;
+    std::vector<std::pair<std::uint32_t, double>> weak;
+    std::bitset<KeyStats::bigrams> weak_set;
+    double weak_total = 0.0;
+};
+
+/* an endless run of space separated words, generated only as positions are asked for */
+/* positions are absolute and never reused, only [begin, end) is kept, drop_before gives the rest back */
+class WordStream {
+public:
+    explicit WordStream(WordGenerator &generator) : generator(generator) {}
+
+    /* false only if the generator has no words at all */
+    bool reach(std::uint64_t i) {
+        while (i >= end()) {
+            if (generator.empty()) { return false; }
+            if (end() > 0) { push(' '); }
+            for (const char c : generator.next()) { push(c); }
+        }
+        return true;
+    }
+
+    [[nodiscard]] std::uint64_t begin() const { return base; }
+    [[nodiscard]] std::uint64_t end() const { return base + text.size(); }
+
+    /* i must be in [begin, end) */
+    [[nodiscard]] char operator[](std::uint64_t i) const { return text[i - base]; }
+    [[nodiscard]] chstate state(std::uint64_t i) const { return states[i - base]; }
+    void set_state(std::uint64_t i, chstate state) { states[i - base] = state; }
+
+    void drop_before(std::uint64_t i) {
+        const std::size_t n = std::min<std::uint64_t>(i, end()) - std::min(i, base);
+        text.erase(0, n);
+        states.erase(states.begin(), states.begin() + static_cast<std::ptrdiff_t>(n));
+        base += n;
+    }
+
+private:
+    void push(char c) {
+        text.push_back(c);
+        states.push_back(chstate::original);
+    }
+
+    WordGenerator &generator;
+    std::uint64_t base = 0;
+    std::string text;
+    std::vector<chstate> states;
+};
+
+/* wraps a WordStream on word boundaries into width columns and keeps only lines visible lines laid out */
+/* the caret sits on the middle line once there is one, reaching the line after it scrolls everything up by one */
+class LineLayout {
+public:
+    static constexpr std::size_t lines = 3;
+
+    LineLayout(WordStream &stream, std::int32_t width) : stream(stream), width(std::max(width, 2)) {
+        starts[0] = stream.begin();
+        for (std::size_t l = 1; l < starts.size(); l++) {
+            starts[l] = next_break(starts[l - 1]);
+        }
+    }
+
+    /* wraps the visible lines again from the first one, follow p afterwards in case it ended up further down */
+    void resize(std::int32_t new_width) {
+        width = std::max(new_width, 2);
+        for (std::size_t l = 1; l < starts.size(); l++) {
+            starts[l] = next_break(starts[l - 1]);
+        }
+    }
+
+    /* scrolls until p is back on the first two lines, true if anything moved */
+    bool follow(std::uint64_t p) {
+        bool moved = false;
+        while (p >= starts[lines - 1]) {
+            std::shift_left(starts.begin(), starts.end(), 1);
+            starts.back() = next_break(starts[lines - 1]);
+            stream.drop_before(starts[0]);
+            moved = true;
+        }
+        return moved;
+    }
+
+    /* visible line l covers [line_begin(l), line_end(l)), the trailing space included */
+    [[nodiscard]] std::uint64_t line_begin(std::size_t l) const { return starts[l]; }
+    [[nodiscard]] std::uint64_t line_end(std::size_t l) const { return starts[l + 1]; }
+
+    /* p must be visible */
+    [[nodiscard]] std::pair<std::int32_t, std::int32_t> position(std::uint64_t p) const {
+        std::size_t l = 0;
+        for (; l + 1 < lines && p >= starts[l + 1]; l++) {;}
+        return {static_cast<std::int32_t>(l), static_cast<std::int32_t>(p - starts[l])};
+    }
+
+private:
+    /* the start of the line after the one starting at start, a word longer than a line is split */
+    std::uint64_t next_break(std::uint64_t start) {
+        std::uint64_t pos = start;
+        while (true) {
+            std::uint64_t k = pos;
+            for (; stream.reach(k) && stream[k] != ' '; k++) {;}
+            if (k + 1 - start > static_cast<std::uint64_t>(width)) {
+                return pos == start ? start + width - 1 : pos;
+            }
+            pos = k + 1;
+        }
+    }
+
+    WordStream &stream;
+    std::int32_t width;
+    std::array<std::uint64_t, lines + 1> starts{};
+};
+
+
+/* quotes/<lang>.json compiled to quotes/<lang>.bin: */
+/* Header, then per Quote group a contiguous run of {offset, length} entries pointing into the blob, then the blob */
+/* picking a quote touches one entry and the pages holding its text, nothing else is ever read */
+class QuoteStore {
+public:
+    static constexpr std::array<char, 8> magic = {'s', 'i', 'm', 'q', 'u', 'o', 't', 'e'};
+    static constexpr std::uint32_t version = 1;
+    static constexpr std::size_t groups = Quote::szthicc + 1;
+
+    struct Entry {
+        std::uint32_t offset, length;
+    };
+
+    struct Header {
+        CacheHeader base;
+        std::array<std::uint32_t, groups> group_begin, group_count;
+        std::uint64_t blob_size;
+    };
+
+    [[nodiscard]] bool is_open() const { return header != nullptr; }
+    [[nodiscard]] std::size_t count(Quote size) const { return header->group_count[size]; }
+
+    /* O(1), caller checks count(size) first */
+    template <typename Engine>
+    std::string_view pick(Quote size, Engine &engine) const {
+        std::uniform_int_distribution<std::uint32_t> dist(0, header->group_count[size] - 1);
+        const Entry &entry = entries[header->group_begin[size] + dist(engine)];
+        return {blob + entry.offset, entry.length};
+    }
+
+    bool open(const std::string &cache_filename, const SourceStamp &source) {
+        std::optional<MappedFile> mapped = open_cache<Header>(cache_filename, magic, version, source);
+        if (!mapped.has_value()) { return false; }
+        const auto *h = reinterpret_cast<const Header *>(mapped->data());
+        if (mapped->size() != sizeof(Header) + h->base.count * sizeof(Entry) + h->blob_size) { return false; }
+
+        file = std::move(mapped.value());
+        header = reinterpret_cast<const Header *>(file.data());
+        entries = reinterpret_cast<const Entry *>(file.data() + sizeof(Header));
+        blob = file.data() + sizeof(Header) + header->base.count * sizeof(Entry);
+        return true;
+    }
+
+    /* streams the json through a SAX reader, so even compiling never holds more than the quote texts */
+    static bool compile(const std::string &json_filename, const std::string &cache_filename) {
+        /* "groups": [[0, 100], [101, 300], ...], */
+        /* "quotes": [ */
+        /*     { */
+        /*         "text": "You can't use the fire exit because you're not made of fire.", */
+        /*         "source": "Undertale", */
+        /*         "id": 12, */
+        /*         "length": 60 */
+        /*     } */
+        /* ] */
+        struct Handler : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Handler> {
+            std::int32_t depth = 0;
+            std::string section, key;
+            std::vector<std::uint64_t> bounds;
+            std::vector<Entry> quotes;
+            std::string text_blob;
+
+            bool StartObject() { depth++; return true; }
+            bool EndObject(rapidjson::SizeType) { depth--; return true; }
+            bool StartArray() { depth++; return true; }
+            bool EndArray(rapidjson::SizeType) { depth--; return true; }
+
+            bool Key(const char *str, rapidjson::SizeType len, bool) {
+                key.assign(str, len);
+                if (depth == 1) { section = key; }
+                return true;
+            }
+
+            bool String(const char *str, rapidjson::SizeType len, bool) {
+                if (depth == 3 && section == "quotes" && key == "text") {
+                    quotes.push_back(Entry{.offset = static_cast<std::uint32_t>(text_blob.size()), .length = len});
+                    text_blob.append(str, len);
+                }
+                return true;
+            }
+
+            bool Uint(unsigned u) {
+                if (depth == 3 && section == "groups") { bounds.push_back(u); }
+                return true;
+            }
+
+            bool Int(int i) { return i < 0 || Uint(static_cast<unsigned>(i)); }
+        };
+
+        gzFile pfile = gzopen(json_filename.c_str(), "rb");
+        if (pfile == nullptr) { return false; }
+        GzReadStream grs(pfile);
+        Handler handler;
+        rapidjson::Reader reader;
+        const bool parsed = !reader.Parse(grs, handler).IsError();
+        gzclose(pfile);
+        if (!parsed || handler.bounds.size() != groups * 2) { return false; }
+
+        Header header{};
+        std::vector<Entry> sorted;
+        sorted.reserve(handler.quotes.size());
+        for (std::size_t g = 0; g < groups; g++) {
+            header.group_begin[g] = static_cast<std::uint32_t>(sorted.size());
+            for (const Entry &entry : handler.quotes) {
+                if (entry.length >= handler.bounds[g * 2] && entry.length <= handler.bounds[g * 2 + 1]) {
+                    sorted.push_back(entry);
+                }
+            }
+            header.group_count[g] = static_cast<std::uint32_t>(sorted.size()) - header.group_begin[g];
+        }
+        header.base = CacheHeader{.magic = magic, .version = version, .count = static_cast<std::uint32_t>(sorted.size()), .source = source_stamp(json_filename)};
+        header.blob_size = handler.text_blob.size();
+
+        std::string out;
+        out.reserve(sizeof(Header) + sorted.size() * sizeof(Entry) + handler.text_blob.size());
+        append_raw(out, header);
+        out.append(reinterpret_cast<const char *>(sorted.data()), sorted.size() * sizeof(Entry));
+        out.append(handler.text_blob);
+        return write_file_atomic(cache_filename, out);
+    }
+
+private:
+    MappedFile file;
+    const Header *header = nullptr;
+    const Entry *entries = nullptr;
+    const char *blob = nullptr;
+};
+
+/* quotes are shared by every size variant of a language, english_1k reads quotes/english.json */
+void get_quotes(QuoteStore &outs) {
+    const std::string language = settings().language.substr(0, settings().language.find('_'));
+    const std::string quotes_filename = fetch_file("quotes/" + language + ".json", "get_quotes");
+    const std::string cache_filename = "quotes/" + language + ".bin";
+    const SourceStamp stamp = source_stamp(quotes_filename);
+    if (outs.open(cache_filename, stamp)) { return; }
+
+    if (!QuoteStore::compile(quotes_filename, cache_filename) || !outs.open(cache_filename, stamp)) {
+        deinit_ncurses();
+        std::cerr << "fatal: get_quotes: failed to compile " << quotes_filename << " into " << cache_filename << '\n';
+        exit(1);
+    }
+}
+
+
+/* one finished test, fixed size so the history file can be indexed and mapped as an array */
+struct HistoryRecord {
+    std::int64_t timestamp; /* unix seconds */
+    float wpm, raw, accuracy, consistency;
+    std::uint32_t count; /* words for words mode, seconds for timed, Quote group for quote */
+    std::uint8_t mode;
+    std::uint8_t flags;
+    std::uint16_t reserved;
+
+    static constexpr std::uint8_t flag_broken = 1;
+};
+static_assert(sizeof(HistoryRecord) == 32);
+
+/* history.bin is a 16 byte header followed by HistoryRecords, only ever appended to */
+/* history.idx keeps per (mode, count) run counts, bests and a wpm histogram so queries never touch history.bin */
+/* several simian processes may share them, an flock on history.bin covers every append together with its index rewrite */
+class HistoryStore {
+public:
+    static constexpr std::array<char, 8> magic = {'s', 'i', 'm', 'h', 'i', 's', 't', ' '};
+    static constexpr std::array<char, 8> index_magic = {'s', 'i', 'm', 'h', 'i', 'd', 'x', ' '};
+    static constexpr std::uint32_t version = 1;
+    static constexpr std::size_t header_size = 16;
+    static constexpr std::size_t histogram_bins = 320; /* 1 wpm each, the last one catches everything above */
+
+    struct Summary {
+        std::uint8_t mode;
+        std::uint32_t count;
+        std::uint64_t runs = 0;
+        float best_wpm = 0.0F;
+        std::int64_t best_timestamp = 0;
+        std::array<std::uint32_t, histogram_bins> histogram{};
+    };
+
+    HistoryStore(std::string filename, std::string index_filename) : filename(std::move(filename)), index_filename(std::move(index_filename)) {
+        load_index();
+        writer = std::jthread([this](std::stop_token stoken) { write_loop(stoken); });
+    }
+
+    HistoryStore(const HistoryStore &) = delete;
+    HistoryStore &operator=(const HistoryStore &) = delete;
+
+    /* drains whatever is still queued before returning */
+    ~HistoryStore() {
+        std::lock_guard guard(queue_mutex);
+        writer.request_stop();
+        queue_cv.notify_one();
+    }
+
+    /* never blocks on disk, the writer thread picks it up */
+    void submit(const HistoryRecord &record) {
+        {
+            std::lock_guard guard(queue_mutex);
+            queue.push_back(record);
+        }
+        queue_cv.notify_one();
+    }
+
+    [[nodiscard]] std::optional<Summary> summary(std::uint8_t mode, std::uint32_t count) const {
+        std::lock_guard guard(index_mutex);
+        auto it = summaries.find(key(mode, count));
+        if (it == summaries.end()) { return std::nullopt; }
+        return it->second;
+    }
+
+    /* q in [0, 1], resolution is one wpm */
+    static float percentile(const Summary &summary, double q) {
+        const auto target = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(summary.runs)));
+        std::uint64_t seen = 0;
+        for (std::size_t bin = 0; bin < histogram_bins; bin++) {
+            seen += summary.histogram[bin];
+            if (seen >= std::max<std::uint64_t>(target, 1)) { return static_cast<float>(bin); }
+        }
+        return static_cast<float>(histogram_bins - 1);
+    }
+
+private:
+    struct IndexHeader {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t entries;
+        std::uint64_t records_indexed;
+    };
+
+    static std::uint64_t key(std::uint8_t mode, std::uint32_t count) { return (static_cast<std::uint64_t>(mode) << 32) | count; }
+
+    /* broken runs are kept in history.bin but stay out of bests and percentiles */
+    void index_record(const HistoryRecord &record) {
+        records_indexed++;
+        if (record.flags & HistoryRecord::flag_broken) { return; }
+        Summary &summary = summaries.try_emplace(key(record.mode, record.count), Summary{.mode = record.mode, .count = record.count}).first->second;
+        summary.runs++;
+        if (record.wpm > summary.best_wpm) {
+            summary.best_wpm = record.wpm;
+            summary.best_timestamp = record.timestamp;
+        }
+        summary.histogram[std::min<std::size_t>(static_cast<std::size_t>(std::max(0.0F, record.wpm)), histogram_bins - 1)]++;
+    }
+
+    /* trusts history.idx for the records it covers and only scans what was appended after it */
+    void load_index() {
+        const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) { flock(fd, LOCK_SH); } /* no append can land between the two files being read */
+        MappedFile history(filename);
+        const std::uint64_t records = history.size() > header_size ? (history.size() - header_size) / sizeof(HistoryRecord) : 0;
+
+        MappedFile index(index_filename);
+        bool fresh = false;
+        if (index.size() >= sizeof(IndexHeader)) {
+            const auto *header = reinterpret_cast<const IndexHeader *>(index.data());
+            fresh = header->magic == index_magic && header->version == version && header->records_indexed <= records
+                && index.size() == sizeof(IndexHeader) + header->entries * sizeof(Summary);
+            if (fresh) {
+                const auto *entries = reinterpret_cast<const Summary *>(index.data() + sizeof(IndexHeader));
+                for (std::uint32_t i = 0; i < header->entries; i++) {
+                    summaries.emplace(key(entries[i].mode, entries[i].count), entries[i]);
+                }
+                records_indexed = header->records_indexed;
+            }
+        }
+
+        const auto *all = reinterpret_cast<const HistoryRecord *>(history.data() + header_size);
+        for (std::uint64_t i = records_indexed; i < records; i++) {
+            index_record(all[i]);
+        }
+        if (!fresh || records_indexed != records) { save_index(); }
+        if (fd >= 0) { close(fd); }
+    }
+
+    /* folds in whatever other processes appended to fd since this one last indexed, so save_index never drops their records */
+    void catch_up(int fd, std::uint64_t file_size) {
+        const std::uint64_t records = file_size > header_size ? (file_size - header_size) / sizeof(HistoryRecord) : 0;
+        std::vector<HistoryRecord> chunk(4096);
+        while (records_indexed < records) {
+            const std::uint64_t n = std::min<std::uint64_t>(chunk.size(), records - records_indexed);
+            const auto offset = static_cast<off_t>(header_size + records_indexed * sizeof(HistoryRecord));
+            if (pread(fd, chunk.data(), n * sizeof(HistoryRecord), offset) != static_cast<ssize_t>(n * sizeof(HistoryRecord))) { return; }
+            for (std::uint64_t i = 0; i < n; i++) {
+                index_record(chunk[i]);
+            }
+        }
+    }
+
+    /* written field by field into zeroed copies, so no uninitialized padding ends up on disk */
+    void save_index() const {
+        std::string out;
+        IndexHeader header{};
+        header.magic = index_magic;
+        header.version = version;
+        header.entries = static_cast<std::uint32_t>(summaries.size());
+        header.records_indexed = records_indexed;
+        append_raw(out, header);
+        for (const auto &[k, summary] : summaries) {
+            Summary entry{};
+            entry.mode = summary.mode;
+            entry.count = summary.count;
+            entry.runs = summary.runs;
+            entry.best_wpm = summary.best_wpm;
+            entry.best_timestamp = summary.best_timestamp;
+            entry.histogram = summary.histogram;
+            append_raw(out, entry);
+        }
+        write_file_atomic(index_filename, out);
+    }
+
+    void append(const std::vector<HistoryRecord> &batch) {
+        const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) { return; }
+        flock(fd, LOCK_EX);
+        std::string out;
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            close(fd); /* drops the lock too */
+            return;
+        }
+        {
+            std::lock_guard guard(index_mutex);
+            catch_up(fd, static_cast<std::uint64_t>(st.st_size));
+        }
+        if (st.st_size == 0) {
+            out.append(magic.data(), magic.size());
+            append_raw(out, version);
+            append_raw(out, static_cast<std::uint32_t>(sizeof(HistoryRecord)));
+        }
+        out.append(reinterpret_cast<const char *>(batch.data()), batch.size() * sizeof(HistoryRecord));
+        const bool written = write(fd, out.data(), out.size()) == static_cast<ssize_t>(out.size());
+        if (written) {
+            std::lock_guard guard(index_mutex);
+            for (const HistoryRecord &record : batch) {
+                index_record(record);
+            }
+            save_index();
+        }
+        close(fd);
+    }
+
+    /* sleeps until something is submitted, then gives it a couple of seconds to gather company and writes the lot at once */
+    void write_loop(const std::stop_token &stoken) {
+        std::vector<HistoryRecord> batch;
+        while (true) {
+            {
+                std::unique_lock guard(queue_mutex);
+                queue_cv.wait(guard, [&]() { return !queue.empty() || stoken.stop_requested(); });
+                const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+                queue_cv.wait_until(guard, deadline, [&]() { return stoken.stop_requested(); });
+                if (queue.empty() && stoken.stop_requested()) { return; }
+                batch.swap(queue);
+            }
+            append(batch);
+            batch.clear();
+        }
+    }
+
+    std::string filename, index_filename;
+
+    mutable std::mutex index_mutex;
+    std::map<std::uint64_t, Summary> summaries;
+    std::uint64_t records_indexed = 0;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::vector<HistoryRecord> queue;
+    std::jthread writer; /* last, so it stops before the rest is destroyed */
+};
+
+
+void get_themes_list(std::vector<std::string> &outs) {
+    /* [ */
+    /*     { */
+    /*         "name": "oblivion", */
+    /*         "bgColor": "#313231", */
+    /*         "mainColor": "#a5a096", */
+    /*         "subColor": "#5d6263", */
+    /*         "textColor": "#f7f5f1" */
+    /*     } */
+    /* ] */
+    
+    const std::string list_filename = "themes/_list.json";
+    fetch_file_cached(list_filename, "get_themes_list");
+    std::FILE *pfile = std::fopen(list_filename.c_str(), "r");
+    rapidjson::Document doc;
+    const std::uintmax_t size = std::filesystem::file_size(list_filename);
+    char *contents = new char[size];
+    rapidjson::FileReadStream frs(pfile, contents, size);
+    doc.ParseStream(frs);
+    for (const auto &theme : doc.GetArray()) {
+        outs.emplace_back(theme["name"].GetString());
+    }
+    std::fclose(pfile);
+    delete[] contents;
+}
+
+/* index of the closest color in the xterm 6x6x6 cube or gray ramp, theme colors run 0 to 256 */
+std::int16_t nearest_xterm256(const RGB &c) {
+    static constexpr std::array<int, 6> levels = {0, 95, 135, 175, 215, 255};
+    const std::array<int, 3> want = {std::min(255, c.r * 255 / 256), std::min(255, c.g * 255 / 256), std::min(255, c.b * 255 / 256)};
+    auto distance = [&](int r, int g, int b) { return (r - want[0]) * (r - want[0]) + (g - want[1]) * (g - want[1]) + (b - want[2]) * (b - want[2]); };
+
+    std::array<int, 3> cube{};
+    for (std::size_t i = 0; i < 3; i++) {
+        cube[i] = static_cast<int>(std::min_element(levels.begin(), levels.end(), [&](int a, int b) { return std::abs(a - want[i]) < std::abs(b - want[i]); }) - levels.begin());
+    }
+    const int gray = std::clamp(((want[0] + want[1] + want[2]) / 3 - 3) / 10, 0, 23);
+    const int gray_level = 8 + gray * 10;
+    if (distance(gray_level, gray_level, gray_level) < distance(levels[cube[0]], levels[cube[1]], levels[cube[2]])) {
+        return static_cast<std::int16_t>(232 + gray);
+    }
+    return static_cast<std::int16_t>(16 + cube[0] * 36 + cube[1] * 6 + cube[2]);
+}
+
+/* will assign color ids up to base + 30, color pairs up to base + 32 */
+void assign_theme(const std::int16_t &base, Theme &theme) {
+    /* the truecolor backend draws the typing surface itself, everything left on pairs makes do with the stock 256 colors */
+    const bool keep_palette = settings().render_backend == "truecolor" && COLORS >= 256;
+    auto init = [&](std::int16_t pairid, std::int16_t cid2, std::int16_t cid3, const RGB &fg, const RGB &bg) {
+        if (keep_palette) {
+            init_pair(pairid, nearest_xterm256(fg), nearest_xterm256(bg));
+        } else {
+            pair_init(pairid, cid2, cid3, fg, bg);
+        }
+    };
+    /* NOLINTBEGIN */
+    init(base, base + 1, base + 2, theme.main, theme.bg);
+    theme.main_pair = base;
+    init(base + 3, base + 4, base + 5, theme.caret, theme.bg);
+    theme.caret_pair = base + 3;
+    init(base + 6, base + 7, base + 8, theme.sub, theme.bg);
+    theme.sub_pair = base + 6;
+    init(base + 9, base + 10, base + 11, theme.sub_alt, theme.bg);
+    theme.sub_alt_pair = base + 9;
+    init(base + 12, base + 13, base + 14, theme.text, theme.bg);
+    theme.text_pair = base + 12;
+    init(base + 15, base + 16, base + 17, theme.error, theme.bg);
+    theme.error_pair = base + 15;
+    init(base + 18, base + 19, base + 20, theme.error_extra, theme.bg);
+    theme.error_extra_pair = base + 18;
+    init(base + 21, base + 22, base + 23, theme.colorful_error, theme.bg);
+    theme.colorful_error_pair = base + 21;
+    init(base + 24, base + 25, base + 26, theme.colorful_error_extra, theme.bg);
+    theme.colorful_error_extra_pair = base + 24;
+
+    init(base + 27, base + 28, base + 29, theme.bg, theme.bg);
+    theme.bg_pair = base + 27;
+
+    init(base + 30, base + 31, base + 32, theme.bg, theme.caret);
+    theme.caret_inverse_pair = base + 30;
+    /* NOLINTEND */
+}
+
+
+/* css variable name (without the -color suffix) and the Theme member it fills, also the order colors are cached in */
+const std::array<std::pair<std::string_view, RGB Theme::*>, 10> theme_color_fields = {{
+    {"bg", &Theme::bg}, {"main", &Theme::main}, {"caret", &Theme::caret}, {"sub", &Theme::sub}, {"sub-alt", &Theme::sub_alt},
+    {"text", &Theme::text}, {"error", &Theme::error}, {"error-extra", &Theme::error_extra},
+    {"colorful-error", &Theme::colorful_error}, {"colorful-error-extra", &Theme::colorful_error_extra}
+}};
+
+/* fills the colors of theme from a theme css, returns what it choked on */
+std::optional<std::string> parse_theme(std::string text, Theme &theme) {
+    /* parse this better, not all css define in the same order */
+    if (text.find(":root{") == std::string::npos) { return "no :root{ block"; }
+    std::vector<std::string> fcolors;
+    std::size_t beginb = text.find(":root{") + 5, endb = text.find('}', beginb);
     text = text.substr(beginb + 1, endb - beginb - 1);
     split(text, ";", fcolors);
     for (const std::string &f : fcolors) {
@@ -631,40 +3051,146 @@ void get_theme(const std::string &name, Theme &theme) {
         std::string cname = f.substr(beginn, f.find(':') - 6 - beginn); /* 6 is width of "-color" suffix */
         RGB color = strhex_to_rgb(f.substr(beginh));
 
+        const auto *field = std::find_if(theme_color_fields.begin(), theme_color_fields.end(), [&](const auto &fc) { return fc.first == cname; });
+        if (field == theme_color_fields.end()) {
+            return "near \"" + f + "\" - color name \"" + cname + "\" not found";
+        }
+        theme.*(field->second) = color;
+    }
+    return std::nullopt;
+}
+
+/* themes/_themes.bin, the parsed colors of every theme seen so far, so neither startup nor the gallery parse css twice: */
+/* CacheHeader (its source is unused, every entry carries the stamp of its own css), then count Entry records sorted by name */
+class ThemeCache {
+public:
+    static constexpr std::array<char, 8> magic = {'s', 'i', 'm', 't', 'h', 'e', 'm', 'e'};
+    static constexpr std::uint32_t version = 1;
+
+    struct Entry {
+        std::array<char, 48> name; /* nul padded */
+        SourceStamp source;
+        std::array<RGB, theme_color_fields.size()> colors;
+    };
+
+    void load(const std::string &filename) {
+        entries.clear();
+        std::optional<MappedFile> mapped = open_cache<CacheHeader>(filename, magic, version, SourceStamp{});
+        if (!mapped.has_value()) { return; }
+        const auto *header = reinterpret_cast<const CacheHeader *>(mapped->data());
+        if (mapped->size() != sizeof(CacheHeader) + header->count * sizeof(Entry)) { return; }
+        const auto *first = reinterpret_cast<const Entry *>(mapped->data() + sizeof(CacheHeader));
+        entries.assign(first, first + header->count);
+    }
+
+    /* const, so the gallery workers can share it */
+    bool lookup(const std::string &name, const SourceStamp &source, Theme &theme) const {
+        const auto it = find(name);
+        if (it == entries.end() || key(*it) != name || it->source != source) { return false; }
+        for (std::size_t i = 0; i < theme_color_fields.size(); i++) {
+            theme.*(theme_color_fields[i].second) = it->colors[i];
+        }
+        return true;
+    }
+
+    void store(const std::string &name, const SourceStamp &source, const Theme &theme) {
+        if (name.size() >= std::tuple_size_v<decltype(Entry::name)>) { return; }
+        Entry entry{};
+        std::copy(name.begin(), name.end(), entry.name.begin());
+        entry.source = source;
+        for (std::size_t i = 0; i < theme_color_fields.size(); i++) {
+            entry.colors[i] = theme.*(theme_color_fields[i].second);
+        }
+        const auto it = find(name);
+        if (it != entries.end() && key(*it) == name) {
+            *it = entry;
+        } else {
+            entries.insert(it, entry);
+        }
+        dirty = true;
+    }
+
+    void save(const std::string &filename) {
+        if (!dirty) { return; }
+        std::string out;
+        append_raw(out, CacheHeader{.magic = magic, .version = version, .count = static_cast<std::uint32_t>(entries.size()), .source = SourceStamp{}});
+        out.append(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Entry));
+        dirty = !write_file_atomic(filename, out);
+    }
+
+private:
+    static std::string_view key(const Entry &entry) { return {entry.name.data(), std::strlen(entry.name.data())}; }
+
+    std::vector<Entry>::const_iterator find(const std::string &name) const {
+        return std::lower_bound(entries.begin(), entries.end(), std::string_view(name), [](const Entry &e, std::string_view n) { return key(e) < n; });
+    }
+    std::vector<Entry>::iterator find(const std::string &name) {
+        return std::lower_bound(entries.begin(), entries.end(), std::string_view(name), [](const Entry &e, std::string_view n) { return key(e) < n; });
+    }
+
+    std::vector<Entry> entries;
+    bool dirty = false;
+};
+
+void get_theme(const std::string &name, Theme &theme) {
+    const std::string theme_filename = "themes/" + name + ".css";
+
+    if (name == "custom") { /* we do not want to fetch */
+        if (!file_exists(theme_filename)) {
+            deinit_ncurses();
+            std::cerr << "fatal: get_theme: custom theme custom.css file does not exist\n";
+            exit(1);
+        }
+    } else {
+        fetch_file(theme_filename, "get_theme");
+    }
 
-        if (cname == "bg") { theme.bg = color; }
-        else if (cname == "main") { theme.main = color; }
-        else if (cname == "caret") { theme.caret = color; }
-        else if (cname == "sub") { theme.sub = color; }
-        else if (cname == "sub-alt") { theme.sub_alt = color; }
-        else if (cname == "text") { theme.text = color; }
-        else if (cname == "error") { theme.error = color; }
-        else if (cname == "error-extra") { theme.error_extra = color; }
-        else if (cname == "colorful-error") { theme.colorful_error = color; }
-        else if (cname == "colorful-error-extra") { theme.colorful_error_extra = color; }
-        else {
+    const SourceStamp stamp = source_stamp(theme_filename);
+    ThemeCache cache;
+    cache.load(THEME_CACHE_FILENAME);
+    if (!cache.lookup(name, stamp, theme)) {
+        if (std::optional<std::string> error = parse_theme(get_file_content(theme_filename), theme)) {
             deinit_ncurses();
-            std::cerr << "fatal: get_theme: parsing theme " << name << " failed near \"" << f << "\" - color name \"" << cname << "\" not found\n";
+            std::cerr << "fatal: get_theme: parsing theme " << name << " failed " << error.value() << '\n';
             exit(1);
         }
+        cache.store(name, stamp, theme);
+        cache.save(THEME_CACHE_FILENAME);
     }
 
     theme.name = name;
 
     /* just hope that the color ids don't conflict with terminal */
-    assign_theme(static_cast<std::int16_t>(str_rdll("base_color_id", "get_theme")), theme);
+    assign_theme(static_cast<std::int16_t>(settings().base_color_id), theme);
 }
 
-void cleart(const Theme &theme) {
-    nccon(theme.bg_pair);
-    for (std::int_fast32_t r = 0; r < LINES; r++) {
-        for (std::int_fast32_t c = 0; c < COLS; c++) {
-            mvaddch(r, c, ' ');
+/* rewrites the name= line of main.conf, or appends one, leaving every other line as it was */
+/* the snapshot is rebuilt from config right away, so the new value is in effect even if main.conf can't be written */
+bool save_config_option(const std::string &name, const std::string &value) {
+    std::vector<std::string> lines;
+    split(get_file_content(CONFIG_FILENAME), "\n", lines);
+    bool found = false;
+    std::string out;
+    for (std::string &line : lines) {
+        if (line.starts_with(name + "=")) {
+            line = name + "=" + value;
+            found = true;
         }
+        out += line + '\n';
     }
+    if (!found) { out += name + "=" + value + '\n'; }
+    config[name] = value;
+    load_settings();
+    return write_file_atomic(CONFIG_FILENAME, out);
+}
+
+/* fills with the background through erase, then drops the background again so uncolored text keeps the terminal default */
+void cleart(const Theme &theme) {
+    bkgdset(COLOR_PAIR(theme.bg_pair) | ' ');
+    erase();
+    bkgdset(' ');
     move(0, 0);
     refresh();
-    nccoff(theme.bg_pair);
 }
 
 
@@ -677,6 +3203,94 @@ chtype wait_for_char(chtype chr) {
     return cur;
 }
 
+/* blocks on stdin and two timerfds instead of spinning on getch */
+/* ncurses is switched to nonblocking input for the lifetime of the loop */
+class EventLoop {
+public:
+    enum Event : unsigned int {
+        key, timer, tick
+    };
+
+    EventLoop() {
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        tick_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer_fd < 0 || tick_fd < 0) {
+            deinit_ncurses();
+            std::cerr << "fatal: EventLoop: failed to create timerfd: " << std::strerror(errno) << '\n';
+            exit(1);
+        }
+        /* getch on stdscr would refresh it on every poll, reading through an untouched 1x1 window never writes to the tty */
+        input = newwin(1, 1, 0, 0);
+        keypad(input, true);
+        wtimeout(input, 0);
+    }
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    ~EventLoop() {
+        delwin(input);
+        close(timer_fd);
+        close(tick_fd);
+    }
+
+    /* one shot, relative to now, 0 disarms */
+    void set_timer(std::uint64_t ns) {
+        itimerspec spec{};
+        spec.it_value.tv_sec = static_cast<time_t>(ns / std::nano::den);
+        spec.it_value.tv_nsec = static_cast<long>(ns % std::nano::den);
+        timerfd_settime(timer_fd, 0, &spec, nullptr);
+    }
+
+    /* periodic, the first one interval from now, 0 disarms */
+    /* ticks missed while busy collapse into one, so a slow redraw never queues more of them */
+    void set_tick(std::uint64_t ns) {
+        itimerspec spec{};
+        spec.it_value.tv_sec = spec.it_interval.tv_sec = static_cast<time_t>(ns / std::nano::den);
+        spec.it_value.tv_nsec = spec.it_interval.tv_nsec = static_cast<long>(ns % std::nano::den);
+        timerfd_settime(tick_fd, 0, &spec, nullptr);
+    }
+
+    /* term_mutex is only held around getch, never while blocked in poll */
+    Event wait(chtype &chin, std::mutex *term_mutex = nullptr) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard;
+                if (term_mutex != nullptr) { guard = std::unique_lock(*term_mutex); }
+                untouchwin(input); /* a resize touches every window */
+                chin = wgetch(input);
+            }
+            if (chin != ERR) { return Event::key; }
+
+            std::array<pollfd, 3> fds{{
+                {.fd = STDIN_FILENO, .events = POLLIN, .revents = 0},
+                {.fd = timer_fd, .events = POLLIN, .revents = 0},
+                {.fd = tick_fd, .events = POLLIN, .revents = 0}
+            }};
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) { continue; } /* SIGWINCH, getch will report KEY_RESIZE */
+                deinit_ncurses();
+                std::cerr << "fatal: EventLoop: poll failed: " << std::strerror(errno) << '\n';
+                exit(1);
+            }
+
+            std::uint64_t count = 0;
+            if (fds[1].revents & POLLIN) {
+                read(timer_fd, &count, sizeof(count));
+                return Event::timer;
+            }
+            if (fds[2].revents & POLLIN) {
+                read(tick_fd, &count, sizeof(count));
+                return Event::tick;
+            }
+        }
+    }
+
+private:
+    WINDOW *input = nullptr;
+    int timer_fd = -1, tick_fd = -1;
+};
+
 /* haha */
 void addnamestr(const Theme &theme) {
     nccon(theme.text_pair);
@@ -714,19 +3328,130 @@ inline std::int64_t roundlong(const long double &num) {
 }
 
 
-State ask_again(WINDOW *pwin, bool broken, const long double& wpm, const Theme& theme) {
+std::string number_string(const long double &num) {
+    std::array<char, 32> out{};
+    if (settings().show_decimal_places) {
+        std::snprintf(out.data(), out.size(), "%.2Lf", rounddouble(num, 2));
+    } else {
+        std::snprintf(out.data(), out.size(), "%li", roundlong(num));
+    }
+    return out.data();
+}
+
+void addnumber(WINDOW *pwin, const long double &num) {
+    waddstr(pwin, number_string(num).c_str());
+}
+
+/* one line under the text, redrawn in place while typing */
+void draw_live_stats(WINDOW *pwin, std::int32_t row, const TestResult &result, const Theme &theme, DirectTerminal *direct = nullptr) {
+    if (direct != nullptr) {
+        direct->text(row, 0, number_string(result.wpm) + " wpm  " + number_string(result.accuracy) + "% acc");
+        return;
+    }
+    move(row, 0);
+    clrtoeol();
+    nccon(theme.sub_pair);
+    addnumber(pwin, result.wpm);
+    addstr(" wpm  ");
+    addnumber(pwin, result.accuracy);
+    addstr("% acc");
+    nccoff(theme.sub_pair);
+}
+
+/* seconds, custom is the custom_time option, nullopt if backed out of with tab */
+std::optional<std::uint32_t> ask_time_limit(const Theme& theme) {
+    chtype chin = '1';
+
+    do {
+        cleart(theme);
+        nccon(theme.sub_pair);
+        addstr("time [");
+        attron(A_UNDERLINE);
+        addch('1');
+        attroff(A_UNDERLINE);
+        addstr("5, ");
+        attron(A_UNDERLINE);
+        addch('3');
+        attroff(A_UNDERLINE);
+        addstr("0, ");
+        attron(A_UNDERLINE);
+        addch('6');
+        attroff(A_UNDERLINE);
+        addstr("0, 1");
+        attron(A_UNDERLINE);
+        addch('2');
+        attroff(A_UNDERLINE);
+        addstr("0, ");
+        attron(A_UNDERLINE);
+        addch('c');
+        attroff(A_UNDERLINE);
+        addstr(("ustom " + std::to_string(settings().custom_time) + "s]? ").c_str());
+        nccoff(theme.sub_pair);
+        refresh();
+        chin = getch();
+        if (chin == '\t') { return std::nullopt; }
+    } while (chin != '1' && chin != '3' && chin != '6' && chin != '2' && chin != 'c');
+
+    switch (chin) {
+        case '3':
+            return 30;
+        case '6':
+            return 60;
+        case '2':
+            return 120;
+        case 'c':
+            return static_cast<std::uint32_t>(settings().custom_time);
+        default:
+            return 15;
+    }
+}
+
+
+/* previous is what history.idx knew about this mode before the run was submitted */
+State ask_again(WINDOW *pwin, bool broken, const TestResult &result, const std::optional<HistoryStore::Summary> &previous, const Theme& theme) {
     if (!broken) {
         nccon(theme.sub_pair);
         addnewline(pwin);
         waddstr(pwin, "wpm: ");
         nccon(theme.main_pair);
-        if (str_rdb("show_decimal_places", "ask_again")) {
-            wprintw(pwin, "%.2Lf", rounddouble(wpm, 2));
-        } else {
-            wprintw(pwin, "%li", roundlong(wpm));
-        }
+        addnumber(pwin, result.wpm);
+        nccoff(theme.main_pair);
+        waddstr(pwin, "  raw: ");
+        nccon(theme.main_pair);
+        addnumber(pwin, result.raw);
+        nccoff(theme.main_pair);
+        waddstr(pwin, "  acc: ");
+        nccon(theme.main_pair);
+        addnumber(pwin, result.accuracy);
+        waddstr(pwin, "%");
+        nccoff(theme.main_pair);
+        waddstr(pwin, "  consistency: ");
+        nccon(theme.main_pair);
+        addnumber(pwin, result.consistency);
+        waddstr(pwin, "%");
         nccoff(theme.main_pair);
         addnewline(pwin);
+        if (previous.has_value() && previous->runs > 0) {
+            if (result.wpm > previous->best_wpm) {
+                nccon(theme.main_pair);
+                waddstr(pwin, "new best");
+                nccoff(theme.main_pair);
+                waddstr(pwin, ", was ");
+            } else {
+                waddstr(pwin, "best: ");
+            }
+            nccon(theme.main_pair);
+            addnumber(pwin, previous->best_wpm);
+            nccoff(theme.main_pair);
+            waddstr(pwin, "  median: ");
+            nccon(theme.main_pair);
+            addnumber(pwin, HistoryStore::percentile(*previous, 0.5));
+            nccoff(theme.main_pair);
+            waddstr(pwin, "  over ");
+            addnumber(pwin, static_cast<long double>(previous->runs));
+            waddstr(pwin, previous->runs == 1 ? " run" : " runs");
+            addnewline(pwin);
+        }
         addstr("again [");
         nccon(theme.main_pair);
         attron(A_UNDERLINE);
@@ -765,8 +3490,102 @@ State ask_again(WINDOW *pwin, bool broken, const long double& wpm, const Theme&
     return State::cont;
 }
 
+/* a list of names json is either an array of names or an array of objects with a name, like themes/_list.json */
+/* read through gzread, so a manifest left gzipped by an older version still parses; anything that doesn't is fatal */
+std::vector<std::string> read_list_names(const std::string &filename, const std::string &origin) {
+    std::vector<std::string> names;
+    gzFile pfile = gzopen(filename.c_str(), "rb");
+    if (pfile == nullptr) {
+        deinit_ncurses();
+        std::cerr << "fatal: " << origin << ": could not open " << filename << '\n';
+        exit(1);
+    }
+    rapidjson::Document doc;
+    GzReadStream grs(pfile);
+    doc.ParseStream(grs);
+    gzclose(pfile);
+    if (doc.HasParseError() || !doc.IsArray()) {
+        deinit_ncurses();
+        std::cerr << "fatal: " << origin << ": " << filename << " is not a json array of names\n";
+        exit(1);
+    }
+    for (const auto &entry : doc.GetArray()) {
+        if (entry.IsString()) {
+            names.emplace_back(entry.GetString());
+        } else if (entry.IsObject() && entry.HasMember("name") && entry["name"].IsString()) {
+            names.emplace_back(entry["name"].GetString());
+        }
+    }
+    return names;
+}
+
+/* type to filter picker over index, returns the chosen id, or nothing on [tab] */
+/* highlighted is called with the highlighted id after the list is drawn, to draw a preview under it */
+std::optional<std::uint32_t> ask_pick(FuzzyIndex &index, const std::string &title, std::uint32_t initial, const Theme &theme, const std::function<void(std::uint32_t)> &highlighted) {
+    std::string query;
+    std::size_t selected = 0, top = 0;
+    const std::vector<std::uint32_t> *shown = &index.update(query, index.size());
+    if (const auto it = std::find(shown->begin(), shown->end(), initial); it != shown->end()) {
+        selected = static_cast<std::size_t>(it - shown->begin());
+    }
+
+    while (true) {
+        const std::size_t rows = std::max(1, LINES - 5);
+        if (selected < top) { top = selected; }
+        if (selected >= top + rows) { top = selected - rows + 1; }
+
+        cleart(theme);
+        nccon(theme.text_pair);
+        attron(A_BOLD);
+        mvaddstr(0, 0, (title + " (" + std::to_string(shown->size()) + ")").c_str());
+        attroff(A_BOLD);
+        nccoff(theme.text_pair);
+        nccon(theme.sub_pair);
+        addstr("  type to filter, [enter] to keep, [tab] to go back");
+        nccoff(theme.sub_pair);
+        for (std::size_t r = 0; r < rows && top + r < shown->size(); r++) {
+            const bool is_selected = top + r == selected;
+            const std::int16_t pair = is_selected ? theme.main_pair : theme.sub_pair;
+            nccon(pair);
+            if (is_selected) { attron(A_BOLD); }
+            mvaddstr(static_cast<int>(r) + 2, 0, (std::string(is_selected ? "> " : "  ") + index[(*shown)[top + r]]).c_str());
+            if (is_selected) { attroff(A_BOLD); }
+            nccoff(pair);
+        }
+        if (!shown->empty()) { highlighted((*shown)[selected]); }
+        nccon(theme.text_pair);
+        mvaddstr(1, 0, ("/" + query).c_str());
+        nccoff(theme.text_pair);
+        refresh();
+
+        const chtype chin = getch();
+        if (chin == KEY_UP) {
+            selected = selected == 0 ? std::max<std::size_t>(shown->size(), 1) - 1 : selected - 1;
+        } else if (chin == KEY_DOWN) {
+            selected = selected + 1 >= shown->size() ? 0 : selected + 1;
+        } else if (chin == KEY_PPAGE) {
+            selected -= std::min(selected, rows);
+        } else if (chin == KEY_NPAGE) {
+            selected = std::min(std::max<std::size_t>(shown->size(), 1) - 1, selected + rows);
+        } else if (chin == '\n') {
+            if (!shown->empty()) { return (*shown)[selected]; }
+        } else if (chin == '\t') {
+            return std::nullopt;
+        } else if (chin == KEY_BACKSPACE || chin == 127) {
+            if (query.empty()) { continue; }
+            query.pop_back();
+            shown = &index.update(query, index.size());
+            selected = 0;
+        } else if (chin >= ' ' && chin <= '~') {
+            query.push_back(static_cast<char>(chin));
+            shown = &index.update(query, index.size());
+            selected = 0;
+        }
+    }
+}
+
 enum Mode : unsigned int {
-    words, timed, zen, help, end
+    words, timed, quote, zen, help, themes, languages, custom, end
 };
 
 Mode ask_mode(WINDOW *pwin, const Theme& theme) {
@@ -789,7 +3608,11 @@ Mode ask_mode(WINDOW *pwin, const Theme& theme) {
         attron(A_UNDERLINE);
         addch('w');
         attroff(A_UNDERLINE);
-        addstr("ords, ");
+        addstr("ords, q");
+        attron(A_UNDERLINE);
+        addch('u');
+        attroff(A_UNDERLINE);
+        addstr("ote, ");
         attron(A_UNDERLINE);
         addch('z');
         attroff(A_UNDERLINE);
@@ -797,14 +3620,26 @@ Mode ask_mode(WINDOW *pwin, const Theme& theme) {
         attron(A_UNDERLINE);
         addch('h');
         attroff(A_UNDERLINE);
-        addstr("elp, ");
+        addstr("elp, th");
+        attron(A_UNDERLINE);
+        addch('e');
+        attroff(A_UNDERLINE);
+        addstr("mes, ");
+        attron(A_UNDERLINE);
+        addch('l');
+        attroff(A_UNDERLINE);
+        addstr("anguage, ");
+        attron(A_UNDERLINE);
+        addch('c');
+        attroff(A_UNDERLINE);
+        addstr("ustom, ");
         attron(A_UNDERLINE);
         addch('q');
         attroff(A_UNDERLINE);
         addstr("uit]? ");
         refresh();
         chin = getch();
-    } while (chin != 'w' && chin != 't' && chin != 'z' && chin != 'h' && chin != 'q');
+    } while (chin != 'w' && chin != 't' && chin != 'u' && chin != 'z' && chin != 'h' && chin != 'e' && chin != 'l' && chin != 'c' && chin != 'q');
 
     switch (chin) {
         case 'w':
@@ -813,12 +3648,24 @@ Mode ask_mode(WINDOW *pwin, const Theme& theme) {
         case 't':
             return Mode::timed;
             break;
+        case 'u':
+            return Mode::quote;
+            break;
         case 'z':
             return Mode::zen;
             break;
         case 'h':
             return Mode::help;
             break;
+        case 'e':
+            return Mode::themes;
+            break;
+        case 'l':
+            return Mode::languages;
+            break;
+        case 'c':
+            return Mode::custom;
+            break;
         case 'q':
             return Mode::end;
             break;
@@ -828,149 +3675,345 @@ Mode ask_mode(WINDOW *pwin, const Theme& theme) {
 }
 
 
-namespace modes {
+/* nullopt if backed out of with tab */
+std::optional<Quote> ask_quote_length(const Theme& theme) {
+    chtype chin = 's';
 
-    State timed(WINDOW *pwin, std::vector<std::string>& words, std::default_random_engine& engine, const Theme& theme) {
+    do {
         cleart(theme);
-        std::shuffle(words.begin(), words.end(), engine);
+        nccon(theme.sub_pair);
+        addstr("quote length [");
+        attron(A_UNDERLINE);
+        addch('s');
+        attroff(A_UNDERLINE);
+        addstr("hort, ");
+        attron(A_UNDERLINE);
+        addch('m');
+        attroff(A_UNDERLINE);
+        addstr("edium, ");
+        attron(A_UNDERLINE);
+        addch('l');
+        attroff(A_UNDERLINE);
+        addstr("ong, ");
+        attron(A_UNDERLINE);
+        addch('t');
+        attroff(A_UNDERLINE);
+        addstr("hicc]? ");
+        nccoff(theme.sub_pair);
+        refresh();
+        chin = getch();
+        if (chin == '\t') { return std::nullopt; }
+    } while (chin != 's' && chin != 'm' && chin != 'l' && chin != 't');
+
+    switch (chin) {
+        case 'm':
+            return Quote::szmedium;
+        case 'l':
+            return Quote::szlong;
+        case 't':
+            return Quote::szthicc;
+        default:
+            return Quote::szshort;
+    }
+}
 
-        const std::size_t viewable = std::min(200UL, words.size());
-        constexpr double time_given = 15.0; /* seconds */
 
-        std::string out;
-        for (int i = 0; i < viewable; i++) {
-            out.append(words[i]).append(" ");
+HistoryRecord make_record(Mode mode, std::uint32_t count, const TestResult &result, bool broken) {
+    return HistoryRecord{
+        .timestamp = unix_seconds(),
+        .wpm = static_cast<float>(result.wpm), .raw = static_cast<float>(result.raw),
+        .accuracy = static_cast<float>(result.accuracy), .consistency = static_cast<float>(result.consistency),
+        .count = count, .mode = static_cast<std::uint8_t>(mode), .flags = broken ? HistoryRecord::flag_broken : std::uint8_t{0}, .reserved = 0
+    };
+}
+
+
+namespace modes {
+
+    State timed(WINDOW *pwin, WordGenerator& generator, std::optional<std::uint32_t> &limit, HistoryStore& history, KeyStats& keys, const Theme& theme) {
+        if (!limit.has_value()) {
+            limit = ask_time_limit(theme);
+            if (!limit.has_value()) { return State::switch_mode; }
         }
+        cleart(theme);
 
-        /* take out the final space */ 
-        out = out.substr(0, out.size() - 1);
+        const std::uint64_t time_given = std::uint64_t{limit.value()} * std::nano::den;
+        constexpr std::uint64_t hud_tick = std::nano::den; /* the countdown is in whole seconds */
+        constexpr std::int32_t hud_row = LineLayout::lines + 1;
 
-        if (out.empty()) {
+        if (generator.empty()) {
             mvaddstr(0, 0, "error: mode timed: wordstring was empty");
             refresh();
             getch();
             return State::switch_mode;
         }
 
-        mvaddstr(0, 0, out.c_str());
-        move(0, 0);
-        refresh();
+        /* words are only generated as the layout needs them, and lines scrolled off are dropped */
+        WordStream stream(generator);
+        LineLayout layout(stream, COLS);
+
+        auto put = [&](std::uint64_t i) {
+            const chstate state = stream.state(i);
+            if (state == chstate::err && has_color) { /* got it wrong */
+                attron(A_UNDERLINE);
+                nccon(theme.colorful_error_pair);
+                addch(stream[i]);
+                nccoff(theme.colorful_error_pair);
+                attroff(A_UNDERLINE);
+            } else if (state != chstate::original) {
+                attron(A_BOLD);
+                addch(stream[i]);
+                attroff(A_BOLD);
+            } else {
+                addch(stream[i]);
+            }
+        };
+        auto draw_lines = [&]() {
+            for (std::size_t l = 0; l < LineLayout::lines; l++) {
+                move(static_cast<int>(l), 0);
+                for (std::uint64_t i = layout.line_begin(l); i < layout.line_end(l); i++) { put(i); }
+                bkgdset(COLOR_PAIR(theme.bg_pair) | ' ');
+                clrtoeol();
+                bkgdset(' ');
+            }
+        };
+        auto place_caret = [&](std::uint64_t p) {
+            const auto [row, col] = layout.position(p);
+            move(row, col);
+        };
 
-        std::uint64_t start = 0;
         bool started = false;
+        bool timed_out = false;
+        bool broken = false;
 
-        timeout(0);
-        int chars_done = 0;
+        LiveStats stats;
         chtype chin = 0;
-        int i = 0;
-        for (const char chout : out) {
-            do {
-                chin = getch();
-                if (chin != 0 && !started) {
-                    started = true;
-                    start = current_time();
-                }
-                if (current_time() - start > static_cast<std::uint64_t>(std::nano::den * time_given)) {
+        char prev = ' ';
+        std::uint64_t last_time = get_current_time_ns();
+        std::uint64_t deadline = 0;
+        std::uint64_t p = 0;
+
+        /* net wpm counted like Scorer::correct_word_chars: chars and spaces of words typed without a mistake, */
+        /* plus the current word so far while it has none; there is no backspace here, so a word never becomes clean again */
+        std::uint64_t clean_chars = 0, word_chars = 0;
+        bool word_clean = true;
+        auto correct_word_chars = [&]() { return clean_chars + (word_clean ? word_chars : 0); };
+
+        /* only redrawn on the tick, a keystroke never touches it */
+        auto draw_hud = [&]() {
+            const std::uint64_t now = get_current_time_ns();
+            const std::uint64_t left = !started ? time_given : deadline > now ? deadline - now : 0;
+            move(hud_row, 0);
+            clrtoeol();
+            nccon(theme.main_pair);
+            attron(A_BOLD);
+            addstr((std::to_string((left + std::nano::den - 1) / std::nano::den) + "s").c_str());
+            attroff(A_BOLD);
+            nccoff(theme.main_pair);
+            if (started) {
+                draw_live_stats(pwin, hud_row + 1, stats.result(correct_word_chars(), now), theme);
+            }
+        };
+
+        draw_lines();
+        draw_hud();
+        place_caret(0);
+        refresh();
+
+        EventLoop events;
+        for (;; p++) {
+            stream.reach(p);
+            const char chout = stream[p];
+            /* waits for a key that counts, the timers are the only other things that wake it */
+            while (true) {
+                const EventLoop::Event event = events.wait(chin);
+                if (event == EventLoop::Event::timer) {
+                    timed_out = true;
                     break;
                 }
-                if (chin != 0 && chin != chout) {}
-            } while ((out.size() == i || chout == ' ') && (chin == 0 || chin != chout)); /* to allow checking at the same time we are expecting input: this is instead of threading */
+                if (event == EventLoop::Event::tick) {
+                    draw_hud();
+                    place_caret(p);
+                    refresh();
+                    continue;
+                }
+                if (event != EventLoop::Event::key) { continue; }
+                if (chin == KEY_RESIZE) {
+                    layout.resize(COLS);
+                    layout.follow(p);
+                    cleart(theme);
+                    draw_lines();
+                    draw_hud();
+                    place_caret(p);
+                    refresh();
+                    continue;
+                }
+                if (chin >= KEY_MIN && chin != KEY_DL) { continue; } /* arrows, backspace, resizes and the like are not typing */
+                if (!started) {
+                    /* the test ends on the timerfd expiry itself, not when a loop next notices the clock */
+                    started = true;
+                    deadline = get_current_time_ns() + time_given;
+                    events.set_timer(time_given);
+                    events.set_tick(hud_tick);
+                }
+                if (chout != ' ' || chin == chout || chin == '\t' || chin == KEY_DL) { break; }
+            }
 
-            if (chin == chout) { chars_done++; }
+            if (timed_out) { break; }
             if (chin == '\t' || chin == KEY_DL) {
+                broken = true;
                 break;
             }
+            const std::uint64_t now = get_current_time_ns();
+            stats.keystroke(chin == chout, now);
+            keys.record(prev, chout, chin == chout, now - last_time);
+            prev = chout;
+            last_time = now;
+            if (chout == ' ') {
+                if (word_clean) { clean_chars += word_chars + 1; }
+                word_chars = 0;
+                word_clean = true;
+            } else if (chin == chout) {
+                word_chars++;
+            } else {
+                word_clean = false;
+            }
 
-            if (chin != chout && has_color) { /* got it wrong */
-                attron(A_UNDERLINE);
-                nccon(theme.colorful_error_pair);
-                addch(chout);
-                nccoff(theme.colorful_error_pair);
-                attroff(A_UNDERLINE);
+            stream.set_state(p, chin == chout ? chstate::correct : chstate::err);
+            if (layout.follow(p + 1)) {
+                draw_lines(); /* only on a scroll, otherwise just the one char changed */
             } else {
-                attron(A_BOLD);
-                addch(chout);
-                attroff(A_BOLD);
+                place_caret(p);
+                put(p);
             }
+            place_caret(p + 1);
             refresh();
-            i++;
         }
-        timeout(-1); /* reset to what it was previously */
-
-        cleart(theme);
-        const long double wpm = static_cast<long double>(chars_done) * (60.0 / (time_given * chars_per_word));
 
-        addstr(std::to_string(chars_done).c_str());
-        refresh();
+        events.set_tick(0);
 
-        return ask_again(pwin, false, wpm, theme);
-    }
+        /* a finished test is exactly time_given long, however late the expiry was handled */
+        const std::uint64_t now = timed_out ? deadline : get_current_time_ns();
+        stats.roll(now);
+        const TestResult result = stats.result(correct_word_chars(), now);
+        const std::optional<HistoryStore::Summary> previous = history.summary(Mode::timed, limit.value());
+        history.submit(make_record(Mode::timed, limit.value(), result, broken));
+        keys.save(KEYSTATS_FILENAME);
 
-    State words(WINDOW *pwin, std::vector<std::string>& words, std::default_random_engine& engine, const Theme& theme) {
         cleart(theme);
-        nccon(theme.sub_pair);
-        std::shuffle(words.begin(), words.end(), engine);
-
-        constexpr int words_limit = 10;
-
-        std::string out;
-        for (int i = 0; i < words_limit; i++) {
-            out.append(words[i]).append(" ");
-        }
-        
-        if (out.empty()) {
-            mvaddstr(0, 0, "error: mode words: wordstring was empty");
-            refresh();
-            getch();
-            return State::cont;
-        }
+        addstr(std::to_string(stats.correct()).c_str());
+        refresh();
 
-        out.erase(out.end() - 1);
+        return ask_again(pwin, broken, result, previous, theme);
+    }
 
-        addstr(out.c_str());
-        move(0, 0);
-        refresh();
-        std::vector<chinfo_t> buf;
-        buf.reserve(out.size());
+    /* the typing test shared by words, quote and custom: out is the exact text to type, mode and count end up in the history */
+    /* finished, if given, is set to whether the whole text was typed */
+    State typing_test(WINDOW *pwin, const std::string &out, const Theme &theme, HistoryStore &history, KeyStats &keys, Mode mode, std::uint32_t count, bool *finished = nullptr) {
+        std::vector<chinfo_t> text;
+        text.reserve(out.size());
+        std::uint32_t word = 0;
         for (char c : out) {
-            buf.push_back(chinfo_t{.ch = c, .state = chstate::original});
+            if (c == ' ') { word++; }
+            text.push_back(chinfo_t{.ch = c, .state = chstate::original, .word = word});
         }
+        TextBuffer buf(std::move(text));
+        Scorer scorer(out); /* protected by term_mutex */
 
         std::atomic_int32_t p = 0;
-        std::uint64_t start = 0;
-        bool started = false;
         bool broken = false;
-        std::int_fast32_t char_count = 0;
+        LiveStats stats;
 
         curs_set(0);
 
         std::uint64_t begin_time = get_current_time_ns();
         std::vector<std::uint64_t> times = {begin_time}; /* also protected by term_mutex */
         std::mutex term_mutex;
-        std::atomic_bool forwards = true;
-        std::atomic_int pword = 0;
-        std::bitset<words_limit> incorrect_words;
-        std::atomic_int x = 0, y = 0;
-        timeout(0);
+        /* the text gets every row but the blank one and the live stats under it, longer texts scroll */
+        TextLayout layout; /* also protected by term_mutex */
+        layout.reset(buf, COLS, LINES - 2);
+        std::int32_t stats_row = layout.visible_rows() + 1;
+        TextRenderer renderer;
+        std::optional<DirectTerminal> direct_terminal;
+        DirectTerminal *direct = nullptr;
+        if (settings().render_backend == "truecolor") {
+            direct = &direct_terminal.emplace(theme);
+        }
+        renderer.invalidate();
+        renderer.flush(buf, scorer, layout, theme, direct);
+        if (direct != nullptr) {
+            direct->flush();
+        } else {
+            move(0, 0);
+            refresh();
+        }
+
+        /* the stats follow the bottom of the text, a row they leave behind is cleared unless the text took it over */
+        auto draw_stats = [&](std::uint64_t now) {
+            const std::int32_t row = layout.visible_rows() + 1;
+            if (row < stats_row) {
+                if (direct != nullptr) {
+                    direct->text(stats_row, 0, "");
+                } else {
+                    move(stats_row, 0);
+                    clrtoeol();
+                }
+            }
+            stats_row = row;
+            draw_live_stats(pwin, row, stats.result(scorer.correct_word_chars(), now), theme, direct);
+        };
+        /* the only thing that writes to the tty until the test ends */
+        std::optional<Compositor> compositor;
+        compositor.emplace(term_mutex, direct, std::chrono::nanoseconds(std::nano::den / settings().max_fps));
+        EventLoop events;
+        /* bumped on every caret move and on stop, the caret thread parks on it */
+        std::atomic_uint32_t epoch = 0;
         auto anitl = [&](std::stop_token stoken) {
             std::int32_t last_p = p;
-            while (!stoken.stop_requested()) {
-                while (last_p == p) {
-                    if (stoken.stop_requested()) {
-                        return;
-                    }
+            std::uint32_t seen = epoch;
+            while (true) {
+                epoch.wait(seen);
+                if (stoken.stop_requested()) { return; }
+                seen = epoch;
+                const std::int32_t target = p;
+                if (target == last_p) { continue; }
+                {
+                    std::lock_guard guard(term_mutex); /* extras change the size under it */
+                    if (target > buf.size()) { return; }
                 }
-                if (last_p >= buf.size()) { return; }
-                /* now they've changed */
-                animate_caret(term_mutex, y, (last_p += static_cast<std::int16_t>(last_p < p) * 2 - 1), p - last_p, forwards, times, theme, buf, pword, incorrect_words, "mode words");
+                /* only the latest move is animated, a burst of keystrokes never queues up behind it */
+                animate_caret(term_mutex, 0, target, target > last_p, times, theme, buf, layout, scorer, epoch, seen, direct, *compositor);
+                last_p = target;
             }
         };
         std::jthread anit(anitl);
         while (p < buf.size()) {
             chtype chin = ERR;
-            while (chin == ERR) {
+            if (events.wait(chin, &term_mutex) != EventLoop::Event::key) {
+                continue;
+            }
+            if (chin == KEY_RESIZE) {
+                /* rows up to the first one that breaks differently are kept, the viewport is redrawn from scratch */
                 std::lock_guard guard(term_mutex);
-                chin = getch();
+                layout.resize(buf, COLS, LINES - 2);
+                layout.follow(buf, p);
+                if (direct != nullptr) {
+                    direct->clear();
+                } else {
+                    bkgdset(COLOR_PAIR(theme.bg_pair) | ' ');
+                    erase();
+                    bkgdset(' ');
+                }
+                renderer.invalidate();
+                renderer.flush(buf, scorer, layout, theme, direct);
+                stats_row = layout.visible_rows() + 1;
+                if (stats.started()) { draw_stats(times.back()); }
+                if (direct == nullptr) {
+                    const auto [row, col] = layout.position(buf, p);
+                    move(row, col);
+                }
+                compositor->invalidate();
+                continue;
             }
             {
                 std::lock_guard guard(term_mutex);
@@ -990,152 +4033,237 @@ namespace modes {
                 continue;
             }
 
-            std::uint32_t spaces_end = 0;
-
-            x = 0;
-            y = 0;
-            {
-                std::lock_guard guard(term_mutex);
-                getyx(pwin, y, x);
-            }
-            forwards = true;
+            const std::int32_t old_p = p;
+            bool shifted = false;
+            std::lock_guard guard(term_mutex);
             if (chin == KEY_BACKSPACE) {
                 if (p <= 0) { continue; }
-                if (buf[p - 1].state == chstate::err || buf[p - 1].state == chstate::correct) {
-                    buf[p - 1].state = chstate::original;
+                chinfo_t &prev = buf[p - 1];
+                if (prev.ch == ' ') {
+                    scorer.retreat();
+                } else {
+                    scorer.untype(prev.word, prev.state);
                 }
-                if (buf[p].ch == ' ' && buf[p - 1].state == chstate::err_extra) {
-                    buf.erase(buf.begin() + p - 1);
-                    spaces_end++;
+                if (prev.state == chstate::err || prev.state == chstate::correct) {
+                    prev.state = chstate::original;
+                }
+                if (buf[p].ch == ' ' && prev.state == chstate::err_extra) {
+                    const std::uint32_t w = prev.word;
+                    scorer.unextra(w);
+                    buf.erase(p - 1);
+                    layout.resize_unit(buf, w, -1);
+                    shifted = true;
                 }
                 p--;
-                forwards = false;
             } else {
-                if (chin != buf[p].ch) {
+                const char expected = buf[p].ch;
+                const char before = p > 0 ? buf[p - 1].ch : ' ';
+                bool hit = chin == expected;
+                bool skipped = false;
+                if (!hit) {
                     if (chin == ' ') {
                         if (p > 0 ? buf[p - 1].ch == ' ' : true) {
                             continue;
                         }
+                        hit = true; /* skipping the rest of a word is a correct space, the skipped chars count as missed */
+                        skipped = true;
                         std::int32_t k = p;
                         for (; k < buf.size() && buf[k].ch != ' '; k++) {;}
-                        p = k;
+                        scorer.advance(); /* the skipped chars are missed either way */
+                        if (k < buf.size()) {
+                            p = k;
+                        } else {
+                            p = k - 1; /* skipped the last word, which ends the test */
+                        }
                     } else if (p == buf.size() || buf[p].ch == ' ') {
-                        buf.insert(buf.begin() + p, chinfo_t{.ch = static_cast<char>(chin), .state = chstate::err_extra});
+                        const std::uint32_t w = buf[p - 1].word;
+                        scorer.extra(w);
+                        buf.insert(p, chinfo_t{.ch = static_cast<char>(chin), .state = chstate::err_extra, .word = w});
+                        layout.resize_unit(buf, w, 1);
+                        shifted = true;
                     } else {
-                        char_count++;
+                        scorer.incorrect(buf[p].word);
                         buf[p].state = chstate::err;
                     }
                 } else {
+                    if (chin == ' ') {
+                        scorer.advance();
+                    } else {
+                        scorer.correct(buf[p].word);
+                    }
                     buf[p].state = chstate::correct;
-                    char_count++;
                 }
 
-                if (!started) {
-                    start = get_current_time_ns();
-                    started = true;
+                stats.keystroke(hit, times.back());
+                if (!skipped) {
+                    keys.record(before, expected, hit, times.back() - times[times.size() - 2]);
                 }
-
                 p++;
             }
 
-
-            decltype(buf) tbuf;
-            /* both second halves of animation ignore last caret to decrease visual blinking of letters */
-            {
-                std::lock_guard guard(term_mutex);
-                tbuf = buf;
-            }
-            std::int32_t tpword = 0;
-            for (std::int32_t i = p - 1; i >= 0; i--) {
-                if (tbuf[i].ch == ' ') {
-                    tpword++;
-                }
+            /* only the words between the old and new caret can change state or underline, everything else is left alone */
+            std::size_t lo = std::max(0, std::min<std::int32_t>(old_p, p) - 1);
+            for (; lo > 0 && buf[lo - 1].ch != ' '; lo--) {;}
+            std::size_t hi = std::min<std::size_t>(std::max<std::int32_t>(old_p, p), buf.size());
+            for (; hi < buf.size() && buf[hi].ch != ' '; hi++) {;}
+
+            /* an inserted or erased extra char moves the whole tail */
+            renderer.mark(lo, shifted ? std::numeric_limits<std::size_t>::max() : hi);
+            layout.follow(buf, p); /* a scroll is picked up by the renderer on its own */
+            if (direct != nullptr) {
+                direct->hide_cursor();
+            } else {
+                compositor->set_cursor_visible(false);
             }
-            pword = tpword;
+            renderer.flush(buf, scorer, layout, theme, direct);
+            draw_stats(times.back());
+            compositor->invalidate();
+            epoch++;
+            epoch.notify_one();
+        }
 
-            std::bitset<words_limit> incorrect_words;
-            std::int32_t cw = 0;
-            std::int32_t j = 0;
-            for (const chinfo_t &bchar : tbuf) {
-                if (bchar.ch == ' ') {
-                    cw++;
-                    continue;
-                }
-                if (bchar.state == chstate::err || bchar.state == chstate::err_extra || (bchar.state == chstate::original && j < p - 1)) {
-                    incorrect_words[cw] = true;
-                }
-                j++;
-            }
+        anit.request_stop();
+        epoch++;
+        epoch.notify_one();
+        anit.join();
+        compositor.reset(); /* presents whatever is still pending */
 
-            std::int32_t i = 0;
-            cw = 0;
-            for (const chinfo_t &bchar : tbuf) {
-                if (bchar.ch == ' ') {
-                    cw++;
-                }
+        if (direct != nullptr) {
+            /* ncurses only saw the untouched text, hand it the final state before it repaints */
+            direct_terminal.reset();
+            renderer.invalidate();
+            renderer.flush(buf, scorer, layout, theme);
+        }
+        set_cursor_type(CursorType::steady_block);
 
-                {
-                    std::lock_guard guard(term_mutex);
-                    if (incorrect_words[cw] && cw < pword && bchar.ch != ' ') {
-                        attron(A_UNDERLINE);
-                    }
-                    curs_set(0);
-                    move(0, i);
-                    outch(bchar, theme);
-                    if (incorrect_words[cw] && cw < pword && bchar.ch != ' ') {
-                        attroff(A_UNDERLINE);
-                    }
-                }
-                i++;
-            }
-            {
-                std::lock_guard guard(term_mutex);
-                curs_set(0);
-                move(0, i);
-                addstr(std::string(spaces_end, ' ').c_str());
-            }
+        nccoff(theme.sub_pair);
+
+        const std::uint64_t now = get_current_time_ns();
+        stats.roll(now);
+        const TestResult result = stats.result(scorer.correct_word_chars(), now);
+        const std::optional<HistoryStore::Summary> previous = history.summary(mode, count);
+        history.submit(make_record(mode, count, result, broken));
+        keys.save(KEYSTATS_FILENAME);
+        if (finished != nullptr) { *finished = p >= buf.size(); }
+
+        return ask_again(pwin, broken, result, previous, theme);
+    }
+
+    State words(WINDOW *pwin, WordGenerator& generator, HistoryStore& history, KeyStats& keys, const Theme& theme) {
+        cleart(theme);
+        nccon(theme.sub_pair);
+
+        constexpr int words_limit = 10;
+
+        std::string out;
+        generator.fill(out, words_limit);
+        
+        if (out.empty()) {
+            mvaddstr(0, 0, "error: mode words: wordstring was empty");
+            refresh();
+            getch();
+            return State::cont;
+        }
+
+        return typing_test(pwin, out, theme, history, keys, Mode::words, words_limit);
+    }
+
+    /* size is asked for once and kept until the user switches mode */
+    State quote(WINDOW *pwin, QuoteStore &quotes, std::optional<Quote> &size, Xoshiro256& engine, HistoryStore& history, KeyStats& keys, const Theme& theme) {
+        if (!size.has_value()) {
+            size = ask_quote_length(theme);
+            if (!size.has_value()) { return State::switch_mode; }
+        }
+        if (!quotes.is_open()) {
+            get_quotes(quotes);
+        }
 
-            std::lock_guard guard(term_mutex);
+        cleart(theme);
+        nccon(theme.sub_pair);
+
+        static const std::array<std::string, QuoteStore::groups> size_names = {"short", "medium", "long", "thicc"};
+
+        if (quotes.count(size.value()) == 0) {
+            mvaddstr(0, 0, ("error: mode quote: no " + size_names[size.value()] + " quotes for this language").c_str());
+            nccoff(theme.sub_pair);
             refresh();
+            getch();
+            return State::switch_mode;
         }
 
-        anit.request_stop();
-        anit.join();
+        const std::string out(quotes.pick(size.value(), engine));
+        return typing_test(pwin, out, theme, history, keys, Mode::quote, size.value());
+    }
 
-        set_cursor_type(CursorType::steady_block);
+    /* a page of custom_text per test, a finished page moves the saved offset on and the end wraps around to the start */
+    State custom(WINDOW *pwin, CustomText &text, HistoryStore& history, KeyStats& keys, const Theme& theme) {
+        constexpr std::size_t page_chars = 400;
 
-        nccoff(theme.sub_pair);
-        timeout(-1);
+        cleart(theme);
+        nccon(theme.sub_pair);
 
-        /* this is actually the incorrect way to calculate it, check https://monkeytype.com/about */
-        const long double wpm = static_cast<long double>(char_count) * (static_cast<long double>(std::nano::den * 60) / ((current_time() - start) * chars_per_word));
+        const std::string &filename = settings().custom_text;
+        std::string error;
+        if (filename.empty()) {
+            error = "error: mode custom: set custom_text in " + CONFIG_FILENAME + " to the file to type";
+        } else if ((!text.is_open() || text.filename() != filename) && !text.open(filename)) {
+            error = "error: mode custom: could not open \"" + filename + "\"";
+        }
 
-        std::ofstream logf(LOG_FILENAME, std::ios_base::app);
-        logf << std::format("{:%FT%TZ}", std::chrono::system_clock::now()) << " | " << (broken ? "broken " : "") << "words " << words_limit << ": " << wpm << '\n';
-        logf.close();
+        std::string out;
+        std::uint64_t offset = 0, next = 0;
+        if (error.empty()) {
+            /* a file that changed since has nothing left to resume */
+            const CustomProgress progress = CustomProgress::load(CUSTOM_PROGRESS_FILENAME);
+            if (progress.filename == filename && progress.source == text.source() && progress.offset < text.size()) {
+                offset = progress.offset;
+            }
+            next = text.page(offset, page_chars, out);
+            if (out.empty() && offset > 0) { /* only whitespace was left, start over */
+                offset = 0;
+                next = text.page(offset, page_chars, out);
+            }
+            if (out.empty()) {
+                error = "error: mode custom: nothing to type in \"" + filename + "\"";
+            }
+        }
+        if (!error.empty()) {
+            mvaddstr(0, 0, error.c_str());
+            nccoff(theme.sub_pair);
+            refresh();
+            getch();
+            return State::switch_mode;
+        }
+        text.release_before(offset);
 
-        return ask_again(pwin, broken, wpm, theme);
+        const auto words = static_cast<std::uint32_t>(std::count(out.begin(), out.end(), ' ') + 1);
+        bool finished = false;
+        const State res = typing_test(pwin, out, theme, history, keys, Mode::custom, words, &finished);
+        if (finished) {
+            CustomProgress{.filename = filename, .source = text.source(), .offset = next >= text.size() ? 0 : next}.save(CUSTOM_PROGRESS_FILENAME);
+        }
+        return res;
     }
 
-    State zen(WINDOW *pwin, const Theme& theme) {
+    State zen(WINDOW *pwin, HistoryStore& history, const Theme& theme) {
         cleart(theme);
         nccon(theme.main_pair);
-        std::uint_fast32_t char_count = 0;
-        std::uint64_t start = 0;
+        LiveStats stats;
         std::uint16_t curx = 0;
         std::uint16_t cury = 0;
         std::vector<std::int32_t> line_lengths;
 
         chtype chin = '\0';
-        bool started = false;
         std::int32_t this_line_length = 0;
 
         curs_set(1);
+        EventLoop events;
         while (chin != '\t') {
-            chin = getch();
-            if (!started) {
-                started = true;
-                start = current_time();
+            if (events.wait(chin) != EventLoop::Event::key) {
+                continue;
+            }
+            if (chin == '\t') {
+                break;
             }
             if (chin == KEY_BACKSPACE) {
                 getyx(pwin, cury, curx);
@@ -1155,16 +4283,20 @@ namespace modes {
             } else {
                 addch(chin);
                 this_line_length++;
-                char_count++;
+                stats.keystroke(true, get_current_time_ns());
             }
             
             refresh();
         }
         nccoff(theme.main_pair);
         
-        const long double wpm = static_cast<long double>(char_count) * (static_cast<long double>(std::nano::den * 60) / ((current_time() - start) * chars_per_word));
+        const std::uint64_t now = get_current_time_ns();
+        stats.roll(now);
+        const TestResult result = stats.result(stats.correct(), now);
+        const std::optional<HistoryStore::Summary> previous = history.summary(Mode::zen, 0);
+        history.submit(make_record(Mode::zen, 0, result, false));
 
-        return ask_again(pwin, false, wpm, theme);
+        return ask_again(pwin, false, result, previous, theme);
     }
 
     State help(WINDOW *pwin, const Theme& theme) {
@@ -1192,81 +4324,764 @@ namespace modes {
         return State::switch_mode;
     }
 
+    /* every theme in themes/_list.json, loaded and parsed on all cores, previewed live on the whole screen */
+    /* [enter] keeps the highlighted one and saves it to main.conf, [tab] goes back to the old one */
+    State themes(Theme &theme) {
+        cleart(theme);
+        nccon(theme.sub_pair);
+        addstr("loading themes...");
+        refresh();
+
+        std::vector<std::string> names;
+        if (file_exists("themes/custom.css")) { names.emplace_back("custom"); }
+        get_themes_list(names);
+        /* missing themes start downloading and stale ones revalidate in the background, neither holds up the ones on disk */
+        for (const std::string &name : names) {
+            if (name != "custom") { assets().prefetch("themes/" + name + ".css"); }
+        }
+
+        ThemeCache cache;
+        cache.load(THEME_CACHE_FILENAME);
+        std::vector<std::optional<Theme>> loaded(names.size());
+        std::vector<SourceStamp> stamps(names.size());
+        std::vector<char> parsed(names.size(), 0); /* not cached yet, char so workers never share a byte */
+        std::atomic_size_t next = 0;
+        {
+            std::vector<std::jthread> workers(std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, 16));
+            for (std::jthread &worker : workers) {
+                worker = std::jthread([&]() {
+                    for (std::size_t i = next++; i < names.size(); i = next++) {
+                        const std::string filename = "themes/" + names[i] + ".css";
+                        if (names[i] != "custom" && !file_exists(filename) && !assets().prefetch(filename).get().empty()) { continue; }
+                        stamps[i] = source_stamp(filename);
+                        Theme candidate{};
+                        if (!cache.lookup(names[i], stamps[i], candidate)) {
+                            if (parse_theme(get_file_content(filename), candidate).has_value()) { continue; }
+                            parsed[i] = 1;
+                        }
+                        candidate.name = names[i];
+                        loaded[i] = candidate;
+                    }
+                });
+            }
+        }
+        std::vector<Theme> gallery;
+        for (std::size_t i = 0; i < names.size(); i++) {
+            if (!loaded[i].has_value()) { continue; }
+            if (parsed[i]) { cache.store(names[i], stamps[i], loaded[i].value()); }
+            gallery.push_back(loaded[i].value());
+        }
+        cache.save(THEME_CACHE_FILENAME);
+        nccoff(theme.sub_pair);
+
+        if (gallery.empty()) {
+            mvaddstr(0, 0, "error: mode themes: no themes could be loaded");
+            refresh();
+            getch();
+            return State::switch_mode;
+        }
+
+        const auto base = static_cast<std::int16_t>(settings().base_color_id);
+        const Theme original = theme;
+        std::vector<std::string> gallery_names;
+        std::uint32_t initial = 0;
+        for (std::size_t i = 0; i < gallery.size(); i++) {
+            gallery_names.push_back(gallery[i].name);
+            if (gallery[i].name == theme.name) { initial = static_cast<std::uint32_t>(i); }
+        }
+        FuzzyIndex index(std::move(gallery_names));
+
+        /* a line of a test in progress, correct, wrong, extra, caret and untyped */
+        static const std::array<std::pair<std::string_view, std::int16_t Theme::*>, 5> sample = {{
+            {"the quick ", &Theme::main_pair}, {"bworn", &Theme::error_pair}, {"xx", &Theme::error_extra_pair},
+            {"|", &Theme::caret_pair}, {" fox jumps over the lazy dog", &Theme::sub_pair}
+        }};
+        const std::optional<std::uint32_t> picked = ask_pick(index, "themes", initial, theme, [&](std::uint32_t id) {
+            Theme &preview = gallery[id];
+            assign_theme(base, preview); /* same pair ids as theme, so the whole screen recolors at once */
+            move(LINES - 2, 0);
+            for (const auto &[text, pair] : sample) {
+                nccon(preview.*pair);
+                addnstr(text.data(), static_cast<int>(text.size()));
+                nccoff(preview.*pair);
+            }
+        });
+
+        if (!picked.has_value()) {
+            theme = original;
+            assign_theme(base, theme);
+            return State::switch_mode;
+        }
+        theme = gallery[picked.value()];
+        assign_theme(base, theme);
+        if (!save_config_option("theme", theme.name)) {
+            mvaddstr(LINES - 1, 0, ("error: mode themes: could not write " + CONFIG_FILENAME).c_str());
+            refresh();
+            getch();
+        }
+        return State::switch_mode;
+    }
+
+    /* every language in languages/_list.json, the pick is saved to main.conf and used from the next test on */
+    State languages(const Theme &theme) {
+        cleart(theme);
+        /* a mirror made while the manifest was still stored gzipped only has the .gz, which read_list_names reads as well */
+        const std::string list = "languages/_list.json", legacy_list = list + ".gz";
+        const bool legacy = !file_exists(list) && file_exists(legacy_list);
+        const std::vector<std::string> names = read_list_names(legacy ? legacy_list : fetch_file(list, "mode languages"), "mode languages");
+        if (names.empty()) {
+            nccon(theme.sub_pair);
+            mvaddstr(0, 0, "error: mode languages: languages/_list.json has no languages");
+            nccoff(theme.sub_pair);
+            refresh();
+            getch();
+            return State::switch_mode;
+        }
+
+        std::uint32_t initial = 0;
+        for (std::size_t i = 0; i < names.size(); i++) {
+            if (names[i] == settings().language) { initial = static_cast<std::uint32_t>(i); }
+        }
+        FuzzyIndex index(names);
+        const std::optional<std::uint32_t> picked = ask_pick(index, "languages", initial, theme, [](std::uint32_t) {});
+        if (!picked.has_value() || names[picked.value()] == settings().language) { return State::switch_mode; }
+
+        const bool saved = save_config_option("language", names[picked.value()]);
+        assets().prefetch("languages/" + settings().language + ".json");
+        if (!saved) {
+            mvaddstr(LINES - 1, 0, ("error: mode languages: could not write " + CONFIG_FILENAME).c_str());
+            refresh();
+            getch();
+        }
+        return State::switch_mode;
+    }
+
 } /* namespace modes */
 
 
-int main(int argc, char **argv) {
-    /* TODO: maybe option to output template .conf? or theme list or similar */
-    /* if (argc > 1) { */
+namespace history_stats {
 
-    
-    std::setlocale(LC_ALL, "");
+    enum Period : unsigned int {
+        day, month, year, all
+    };
 
-    WINDOW* full_win = init_ncurses();
-    start_color();
+    /* everything here merges, so each thread scans its own slice and the slices are folded at the end */
+    struct Aggregate {
+        static constexpr std::size_t bins = 800; /* half a wpm each, the last one catches everything above */
+
+        std::uint64_t runs = 0;
+        double sum = 0.0;
+        double sum_t = 0.0, sum_tt = 0.0, sum_w = 0.0, sum_tw = 0.0; /* least squares of wpm over days */
+        std::vector<std::uint32_t> histogram;
+
+        void add(const HistoryRecord &record) {
+            if (histogram.empty()) { histogram.resize(bins); }
+            const double t = static_cast<double>(record.timestamp) / 86400.0;
+            runs++;
+            sum += record.wpm;
+            sum_t += t;
+            sum_tt += t * t;
+            sum_w += record.wpm;
+            sum_tw += t * record.wpm;
+            histogram[std::min<std::size_t>(static_cast<std::size_t>(std::max(0.0F, record.wpm) * 2.0F), bins - 1)]++;
+        }
 
-    std::ifstream config_file(CONFIG_FILENAME);
-    if (!config_file.is_open()) {
-        deinit_ncurses();
-        std::cerr << "fatal: main: failed to open config file " << CONFIG_FILENAME << '\n';
-        return 1;
+        void merge(const Aggregate &other) {
+            if (other.runs == 0) { return; }
+            if (histogram.empty()) { histogram.resize(bins); }
+            runs += other.runs;
+            sum += other.sum;
+            sum_t += other.sum_t;
+            sum_tt += other.sum_tt;
+            sum_w += other.sum_w;
+            sum_tw += other.sum_tw;
+            for (std::size_t i = 0; i < bins; i++) {
+                histogram[i] += other.histogram[i];
+            }
+        }
+
+        [[nodiscard]] double mean() const { return runs == 0 ? 0.0 : sum / static_cast<double>(runs); }
+
+        [[nodiscard]] double percentile(double q) const {
+            const auto target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(runs))));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < histogram.size(); i++) {
+                seen += histogram[i];
+                if (seen >= target) { return static_cast<double>(i) / 2.0; }
+            }
+            return 0.0;
+        }
+
+        /* wpm per 30 days */
+        [[nodiscard]] double trend() const {
+            const auto n = static_cast<double>(runs);
+            const double denom = n * sum_tt - sum_t * sum_t;
+            if (runs < 2 || denom == 0.0) { return 0.0; }
+            return 30.0 * (n * sum_tw - sum_t * sum_w) / denom;
+        }
+    };
+
+    /* (mode, count, period) packed so the maps sort by mode, then count, then time */
+    using Key = std::tuple<std::uint8_t, std::uint32_t, std::int64_t>;
+    using Table = std::map<Key, Aggregate>;
+
+    std::int64_t period_of(std::int64_t timestamp, Period period) {
+        const auto days = std::chrono::floor<std::chrono::days>(std::chrono::sys_seconds(std::chrono::seconds(timestamp)));
+        const std::chrono::year_month_day ymd(days);
+        switch (period) {
+            case Period::day:
+                return days.time_since_epoch().count();
+            case Period::month:
+                return static_cast<std::int64_t>(static_cast<int>(ymd.year())) * 100 + static_cast<unsigned>(ymd.month());
+            case Period::year:
+                return static_cast<int>(ymd.year());
+            case Period::all:
+                break;
+        }
+        return 0;
+    }
+
+    std::string period_name(std::int64_t value, Period period) {
+        char out[16];
+        switch (period) {
+            case Period::day: {
+                const std::chrono::year_month_day ymd{std::chrono::sys_days(std::chrono::days(value))};
+                std::snprintf(out, sizeof(out), "%04d-%02u-%02u", static_cast<int>(ymd.year()), static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()));
+                break;
+            }
+            case Period::month:
+                std::snprintf(out, sizeof(out), "%04ld-%02ld", value / 100, value % 100);
+                break;
+            case Period::year:
+                std::snprintf(out, sizeof(out), "%04ld", value);
+                break;
+            case Period::all:
+                std::snprintf(out, sizeof(out), "all");
+                break;
+        }
+        return out;
+    }
+
+    std::string mode_name(std::uint8_t mode, std::uint32_t count) {
+        static const std::array<std::string, 4> quote_sizes = {"short", "medium", "long", "thicc"};
+        switch (mode) {
+            case Mode::words:
+                return "words " + std::to_string(count);
+            case Mode::timed:
+                return "timed " + std::to_string(count) + "s";
+            case Mode::quote:
+                return "quote " + (count < quote_sizes.size() ? quote_sizes[count] : std::to_string(count));
+            case Mode::zen:
+                return "zen";
+            case Mode::custom:
+                return "custom " + std::to_string(count);
+            default:
+                return "mode " + std::to_string(mode);
+        }
+    }
+
+    using Slice = std::pair<const HistoryRecord *, std::size_t>;
+    constexpr std::size_t slice_records = 1 << 18;
+
+    /* up to threads threads claim slices one at a time, each into its own table, and the tables are folded at the end; broken runs are skipped */
+    Table aggregate(const std::vector<Slice> &slices, Period period, std::size_t threads) {
+        threads = std::min<std::size_t>(std::max<std::size_t>(1, threads), std::max<std::size_t>(1, slices.size()));
+        std::vector<Table> tables(threads);
+        std::atomic_size_t next_slice = 0;
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(threads);
+            for (std::size_t t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    /* records mostly arrive in runs of the same key, so skip the map lookup while it repeats */
+                    Key last_key{};
+                    Aggregate *last = nullptr;
+                    for (std::size_t i = next_slice++; i < slices.size(); i = next_slice++) {
+                        const auto [records, count] = slices[i];
+                        for (std::size_t j = 0; j < count; j++) {
+                            const HistoryRecord &record = records[j];
+                            if (record.flags & HistoryRecord::flag_broken) { continue; }
+                            const Key key{record.mode, record.count, period_of(record.timestamp, period)};
+                            if (last == nullptr || key != last_key) {
+                                last = &tables[t][key];
+                                last_key = key;
+                            }
+                            last->add(record);
+                        }
+                    }
+                });
+            }
+        }
+
+        Table merged;
+        for (const Table &table : tables) {
+            for (const auto &[key, aggregate] : table) {
+                merged[key].merge(aggregate);
+            }
+        }
+        return merged;
+    }
+
+    /* every history file is mapped and cut into slices for aggregate, with a thread per core */
+    int run(const std::vector<std::string> &filenames, Period period) {
+        std::vector<MappedFile> files;
+        std::vector<Slice> slices;
+        for (const std::string &filename : filenames) {
+            MappedFile file(filename);
+            if (!file.is_open() || file.size() < HistoryStore::header_size || !std::equal(HistoryStore::magic.begin(), HistoryStore::magic.end(), file.data())) {
+                std::cerr << "fatal: --stats: " << filename << " is not a simian history file\n";
+                return 1;
+            }
+            const auto *records = reinterpret_cast<const HistoryRecord *>(file.data() + HistoryStore::header_size);
+            const std::size_t count = (file.size() - HistoryStore::header_size) / sizeof(HistoryRecord);
+            madvise(const_cast<char *>(file.data()), file.size(), MADV_SEQUENTIAL);
+            files.push_back(std::move(file));
+
+            for (std::size_t begin = 0; begin < count; begin += slice_records) {
+                slices.emplace_back(records + begin, std::min(slice_records, count - begin));
+            }
+        }
+
+        const Table merged = aggregate(slices, period, std::thread::hardware_concurrency());
+        if (merged.empty()) {
+            std::cout << "no finished tests recorded\n";
+            return 0;
+        }
+
+        auto print_row = [](const std::string &name, const Aggregate &aggregate) {
+            std::printf("  %-12s %8lu %8.2f %8.1f %8.1f %8.1f\n", name.c_str(), aggregate.runs, aggregate.mean(), aggregate.percentile(0.5), aggregate.percentile(0.9), aggregate.percentile(0.99));
+        };
+
+        for (auto it = merged.begin(); it != merged.end();) {
+            const std::uint8_t mode = std::get<0>(it->first);
+            const std::uint32_t count = std::get<1>(it->first);
+            std::printf("%s\n  %-12s %8s %8s %8s %8s %8s\n", mode_name(mode, count).c_str(), "period", "runs", "mean", "p50", "p90", "p99");
+
+            Aggregate total;
+            std::vector<double> period_means;
+            for (; it != merged.end() && std::get<0>(it->first) == mode && std::get<1>(it->first) == count; it++) {
+                if (period != Period::all) { print_row(period_name(std::get<2>(it->first), period), it->second); }
+                total.merge(it->second);
+                period_means.push_back(it->second.mean());
+            }
+            print_row("all", total);
+            std::printf("  trend: %+.2f wpm per 30 days", total.trend());
+            if (period != Period::all) {
+                std::printf(", variation between periods: %.1f%%", 100.0 * coeff_variation(period_means));
+            }
+            std::printf("\n\n");
+        }
+        return 0;
+    }
+
+} /* namespace history_stats */
+
+
+namespace bench {
+
+    /* what animate_caret used to pay on every caret move, against the typed snapshot */
+    int config_lookup(std::uint64_t iterations) {
+        load_settings();
+        volatile std::int64_t sink = 0;
+
+        std::uint64_t begin = get_current_time_ns();
+        for (std::uint64_t i = 0; i < iterations; i++) {
+            sink = sink + str_rdll("caret_wait", "mode words") + static_cast<std::int64_t>(str_rdb("smooth_caret", "mode words")) + static_cast<std::int64_t>(str_rdb("xterm_support", "mode words"));
+        }
+        const std::uint64_t map_ns = get_current_time_ns() - begin;
+
+        begin = get_current_time_ns();
+        for (std::uint64_t i = 0; i < iterations; i++) {
+            sink = sink + settings().caret_wait + static_cast<std::int64_t>(settings().smooth_caret) + static_cast<std::int64_t>(settings().xterm_support);
+        }
+        const std::uint64_t snapshot_ns = get_current_time_ns() - begin;
+
+        std::cout << "config lookups per keystroke (caret_wait, smooth_caret, xterm_support), " << iterations << " iterations\n";
+        std::cout << "  string map: " << static_cast<double>(map_ns) / static_cast<double>(iterations) << " ns\n";
+        std::cout << "  snapshot:   " << static_cast<double>(snapshot_ns) / static_cast<double>(iterations) << " ns\n";
+        return 0;
+    }
+
+    /* bytes ncurses sends to the tty, drawn to a temp file through newterm; draw bytes are the clear and the first full draw of the text */
+    /* "cell by cell" reproduces the old paths, an mvaddch per cell to clear the screen and an outch per glyph, */
+    /* "batched" is what replaced them, the background erase in cleart and the run-length output of TextRenderer::flush */
+    int render(std::uint32_t frames) {
+        std::FILE *out = std::tmpfile();
+        std::FILE *in = std::fopen("/dev/null", "r");
+        SCREEN *screen = out != nullptr && in != nullptr ? newterm("xterm-256color", out, in) : nullptr;
+        if (screen == nullptr) {
+            std::cerr << "fatal: bench: newterm for xterm-256color failed\n";
+            return 1;
+        }
+        set_term(screen);
+        start_color();
+        load_settings();
+        Theme theme{};
+        theme.bg = RGB{40, 40, 48};
+        theme.main = RGB{230, 230, 230};
+        theme.sub = RGB{100, 100, 110};
+        theme.caret = theme.sub_alt = theme.text = theme.main;
+        theme.error = theme.error_extra = theme.colorful_error = theme.colorful_error_extra = RGB{220, 60, 60};
+        assign_theme(static_cast<std::int16_t>(settings().base_color_id), theme);
+
+        /* a few lines of words, typed into at random in the same order for both */
+        std::string text;
+        Xoshiro256 words_rng(1);
+        while (text.size() < static_cast<std::size_t>(COLS) * 3) {
+            if (!text.empty()) { text.push_back(' '); }
+            for (std::uint32_t k = 2 + words_rng.below(7); k > 0; k--) { text.push_back(static_cast<char>('a' + words_rng.below(26))); }
+        }
+        std::vector<chinfo_t> cells;
+        std::uint32_t word = 0;
+        for (const char c : text) {
+            if (c == ' ') { word++; }
+            cells.push_back(chinfo_t{.ch = c, .state = chstate::original, .word = word});
+        }
+
+        auto measure = [&](bool batched) {
+            TextBuffer buf{std::vector<chinfo_t>(cells)};
+            const Scorer scorer(text);
+            TextLayout layout;
+            layout.reset(buf, COLS, LINES - 2);
+            TextRenderer renderer;
+            std::vector<chstate> shown(buf.size(), chstate::original);
+
+            std::fflush(out);
+            const long start = std::ftell(out);
+            const std::uint64_t begin = get_current_time_ns();
+
+            if (batched) {
+                cleart(theme);
+                renderer.invalidate();
+                renderer.flush(buf, scorer, layout, theme);
+                refresh();
+            } else {
+                nccon(theme.bg_pair);
+                for (std::int_fast32_t r = 0; r < LINES; r++) {
+                    for (std::int_fast32_t c = 0; c < COLS; c++) {
+                        mvaddch(r, c, ' ');
+                    }
+                }
+                nccoff(theme.bg_pair);
+                for (std::size_t i = 0; i < buf.size(); i++) {
+                    move(static_cast<std::int32_t>(i) / COLS, static_cast<std::int32_t>(i) % COLS);
+                    outch(buf[i], theme);
+                }
+                move(0, 0);
+                refresh();
+            }
+            std::fflush(out);
+            const long cleared = std::ftell(out);
+
+            Xoshiro256 typing_rng(2);
+            for (std::uint32_t f = 0; f < frames; f++) {
+                /* a burst of keystrokes worth of changes per frame */
+                const std::uint32_t from = typing_rng.below(static_cast<std::uint32_t>(buf.size()));
+                for (std::uint32_t i = from; i < std::min<std::uint32_t>(from + 12, buf.size()); i++) {
+                    buf[i].state = static_cast<chstate>(typing_rng.below(4));
+                }
+                if (batched) {
+                    renderer.mark(from, from + 12);
+                    renderer.flush(buf, scorer, layout, theme);
+                } else {
+                    for (std::size_t i = from; i < std::min<std::size_t>(from + 12, buf.size()); i++) {
+                        if (shown[i] == buf[i].state) { continue; }
+                        move(static_cast<std::int32_t>(i) / COLS, static_cast<std::int32_t>(i) % COLS);
+                        outch(buf[i], theme);
+                        shown[i] = buf[i].state;
+                    }
+                }
+                refresh();
+            }
+            std::fflush(out);
+            const std::uint64_t ns = get_current_time_ns() - begin;
+            return std::tuple{cleared - start, std::ftell(out) - cleared, ns};
+        };
+
+        const auto [cell_clear, cell_frames, cell_ns] = measure(false);
+        const auto [run_clear, run_frames, run_ns] = measure(true);
+        endwin();
+        delscreen(screen);
+        std::fclose(out);
+        std::fclose(in);
+
+        std::cout << "render to an " << COLS << "x" << LINES << " xterm-256color, " << frames << " frames\n";
+        std::printf("  %-16s %12s %16s %12s\n", "", "draw bytes", "bytes per frame", "us per frame");
+        std::printf("  %-16s %12ld %16.1f %12.2f\n", "cell by cell", cell_clear, static_cast<double>(cell_frames) / frames, static_cast<double>(cell_ns) / 1000.0 / frames);
+        std::printf("  %-16s %12ld %16.1f %12.2f\n", "batched", run_clear, static_cast<double>(run_frames) / frames, static_cast<double>(run_ns) / 1000.0 / frames);
+        return 0;
+    }
+
+    /* the --stats scan over a generated history.bin of records runs spread over three years, on one thread and on all of them */
+    int history(std::size_t records) {
+        const std::string filename = (std::filesystem::temp_directory_path() / "simian-bench-history.bin").string();
+        {
+            std::string out;
+            out.append(HistoryStore::magic.data(), HistoryStore::magic.size());
+            append_raw(out, HistoryStore::version);
+            append_raw(out, static_cast<std::uint32_t>(sizeof(HistoryRecord)));
+            Xoshiro256 rng(3);
+            std::normal_distribution<float> wpm(70.0F, 15.0F);
+            static constexpr std::array<std::pair<std::uint8_t, std::uint32_t>, 6> kinds = {{
+                {Mode::words, 10}, {Mode::words, 50}, {Mode::timed, 15}, {Mode::timed, 60}, {Mode::quote, 1}, {Mode::zen, 0}
+            }};
+            const std::int64_t start = 1'600'000'000, span = 3LL * 365 * 86400;
+            for (std::size_t i = 0; i < records; i++) {
+                const auto [mode, count] = kinds[rng.below(kinds.size())];
+                const float w = std::max(0.0F, wpm(rng));
+                append_raw(out, HistoryRecord{
+                    .timestamp = start + span * static_cast<std::int64_t>(i) / static_cast<std::int64_t>(records),
+                    .wpm = w, .raw = w * 1.05F, .accuracy = 96.0F, .consistency = 80.0F,
+                    .count = count, .mode = mode, .flags = rng.below(50) == 0 ? HistoryRecord::flag_broken : std::uint8_t{0}, .reserved = 0
+                });
+            }
+            if (!write_file_atomic(filename, out)) {
+                std::cerr << "fatal: bench: could not write " << filename << '\n';
+                return 1;
+            }
+        }
+
+        MappedFile file(filename);
+        const auto *all = reinterpret_cast<const HistoryRecord *>(file.data() + HistoryStore::header_size);
+        std::vector<history_stats::Slice> slices;
+        for (std::size_t begin = 0; begin < records; begin += history_stats::slice_records) {
+            slices.emplace_back(all + begin, std::min(history_stats::slice_records, records - begin));
+        }
+
+        const std::size_t cores = std::max(1U, std::thread::hardware_concurrency());
+        std::cout << "--stats scan of " << records << " records (" << file.size() / (1 << 20) << " MiB), period month\n";
+        for (const std::size_t threads : {std::size_t{1}, cores}) {
+            history_stats::aggregate(slices, history_stats::Period::month, threads); /* page the file in first */
+            const std::uint64_t begin = get_current_time_ns();
+            const history_stats::Table table = history_stats::aggregate(slices, history_stats::Period::month, threads);
+            const std::uint64_t ns = get_current_time_ns() - begin;
+            std::printf("  %3zu thread%s %10.1f ms %8zu rows\n", threads, threads == 1 ? " " : "s", static_cast<double>(ns) / 1e6, table.size());
+            if (cores == 1) { break; }
+        }
+        std::filesystem::remove(filename);
+        return 0;
+    }
+
+} /* namespace bench */
+
+
+/* simian --mirror, fetches every theme, language and quote list in one go for machines that run with offline=true later */
+namespace mirror {
+
+    /* files that are already mirrored and fresh are skipped, interrupted ones resume from their .part */
+    int run(std::size_t jobs) {
+        AssetFetcher fetcher(jobs);
+
+        const std::string themes_list = "themes/_list.json", languages_list = "languages/_list.json";
+        std::shared_future<std::string> themes_fetch = fetcher.prefetch(themes_list);
+        std::shared_future<std::string> languages_fetch = fetcher.prefetch(languages_list);
+        for (const auto &[filename, result] : {std::pair{themes_list, themes_fetch}, std::pair{languages_list, languages_fetch}}) {
+            if (!result.get().empty()) {
+                std::cerr << "fatal: mirror: fetch for " << filename << " failed with " << result.get() << '\n';
+                return 1;
+            }
+        }
+
+        std::vector<std::string> filenames;
+        for (const std::string &name : read_list_names(themes_list, "mirror")) {
+            filenames.push_back("themes/" + name + ".css");
+        }
+        if (filenames.empty()) {
+            std::cerr << "fatal: mirror: " << themes_list << " lists no themes\n";
+            return 1;
+        }
+        std::set<std::string> quote_languages;
+        for (const std::string &name : read_list_names(AssetFetcher::local_path(languages_list), "mirror")) {
+            filenames.push_back("languages/" + name + ".json");
+            quote_languages.insert(name.substr(0, name.find('_')));
+        }
+        /* an empty manifest would leave a mirror that can't run a single test */
+        if (quote_languages.empty()) {
+            std::cerr << "fatal: mirror: " << languages_list << " lists no languages\n";
+            return 1;
+        }
+        for (const std::string &language : quote_languages) {
+            filenames.push_back("quotes/" + language + ".json");
+        }
+
+        std::vector<std::shared_future<std::string>> results;
+        results.reserve(filenames.size());
+        for (const std::string &filename : filenames) {
+            results.push_back(fetcher.prefetch(filename));
+        }
+
+        std::size_t failed = 0, skipped = 0;
+        for (std::size_t i = 0; i < filenames.size(); i++) {
+            const std::string &error = results[i].get();
+            if (error.empty()) { continue; }
+            if (filenames[i].starts_with("quotes/")) { /* most languages have no quotes */
+                skipped++;
+                continue;
+            }
+            std::cerr << "error: mirror: fetch for " << filenames[i] << " failed with " << error << '\n';
+            failed++;
+        }
+        std::cout << "mirrored " << filenames.size() - failed - skipped << " of " << filenames.size() << " files into "
+            << std::filesystem::current_path().string() << " (" << skipped << " languages without quotes)\n";
+        return failed == 0 ? 0 : 1;
     }
 
+} /* namespace mirror */
+
+
+/* reads CONFIG_FILENAME into config, false if it can't be opened; anything odd in it is left in warnings */
+bool read_config(std::vector<std::string> &warnings) {
+    std::ifstream config_file(CONFIG_FILENAME);
+    if (!config_file.is_open()) { return false; }
+
     std::vector<std::string> configkeys;
     configkeys.reserve(config.size());
     for (auto [key, value] : config) {
         configkeys.push_back(key);
     }
 
-    bool needs_confirmation = false;
+    const std::string prefix = "warning: " + CONFIG_FILENAME + " file ";
     std::uint32_t ocount = 0;
-    while (config_file) {
+    std::string line;
+    while (std::getline(config_file, line)) {
+        /* one option per line, the value runs to the end of it so paths may have spaces in them */
+        const std::size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) { continue; }
+        line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
         ocount++;
-        std::string line;
-        config_file >> line;
-        if (line.empty()) { continue; }
-        std::vector<std::string> opts;
-        opts.reserve(2);
-        split(line, "=", opts);
-
-        if (opts.size() < 2) {
-            wprintw(full_win, "warning: %s file %ith config option had %lu tokens ... skipping\n", CONFIG_FILENAME.c_str(), ocount, opts.size());
-            needs_confirmation = true;
+        const std::size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            warnings.push_back(prefix + std::to_string(ocount) + "th config option had no value ... skipping");
             continue;
         }
 
-        if (opts.size() > 2) {
-            wprintw(full_win, "warning: %s file %ith config option had %lu tokens ... using first two\n", CONFIG_FILENAME.c_str(), ocount, opts.size());
-            needs_confirmation = true;
-        }
-
-        std::string name = opts[0], value = opts[1];
-        /* wprintw(full_win, "name: %s, value: %s\n", name.c_str(), value.c_str()); */
+        std::string name = line.substr(0, eq), value = line.substr(eq + 1);
+        name.erase(name.find_last_not_of(" \t") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
         std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
 
         if (!config.contains(name)) {
-            needs_confirmation = true;
-            std::optional<std::pair<std::string, double>> res = extract_one(name, configkeys);
+            const std::optional<std::pair<std::string, double>> res = extract_one(name, configkeys);
+            std::string warning = prefix + std::to_string(ocount) + "th config option \"" + name + "\" not found";
+            if (res.has_value() && res.value().second >= 70) {
+                warning += ", did you mean \"" + res.value().first + "\"?";
+            }
+            warnings.push_back(warning);
+            continue;
+        }
+
+        config[name] = value;
+    }
+    return true;
+}
+
 
-            if (res.has_value()) {
-                /* wprintw(full_win, "score: %f\n", res.value().second); */
-                if (res.value().second < 70) {
-                    wprintw(full_win, "warning: %s file %ith config option \"%s\" not found\n", CONFIG_FILENAME.c_str(), ocount, name.c_str());
+int main(int argc, char **argv) {
+    /* TODO: maybe option to output template .conf? or theme list or similar */
+    if (argc > 1) {
+        const std::string_view cmd = argv[1];
+        if (cmd == "--bench") {
+            /* simian --bench [config|render|history] */
+            const std::string_view which = argc > 2 ? argv[2] : "config";
+            if (which == "render") { return bench::render(10'000); }
+            if (which == "history") { return bench::history(2'000'000); }
+            if (which == "config") { return bench::config_lookup(1'000'000); }
+            std::cerr << "fatal: main: unknown --bench " << which << '\n';
+            return 1;
+        }
+        if (cmd == "--stats") {
+            /* simian --stats [--period day|month|year|all] [history files...] */
+            history_stats::Period period = history_stats::Period::month;
+            std::vector<std::string> filenames;
+            for (int i = 2; i < argc; i++) {
+                const std::string_view arg = argv[i];
+                if (arg == "--period" && i + 1 < argc) {
+                    const std::string_view value = argv[++i];
+                    if (value == "day") { period = history_stats::Period::day; }
+                    else if (value == "month") { period = history_stats::Period::month; }
+                    else if (value == "year") { period = history_stats::Period::year; }
+                    else if (value == "all") { period = history_stats::Period::all; }
+                    else {
+                        std::cerr << "fatal: main: unknown --period " << value << '\n';
+                        return 1;
+                    }
                 } else {
-                    wprintw(full_win, "warning: %s file %ith config option \"%s\" not found, did you mean \"%s\"?\n", CONFIG_FILENAME.c_str(), ocount, name.c_str(), res.value().first.c_str());
+                    filenames.emplace_back(arg);
                 }
-                continue;
             }
-
-            wprintw(full_win, "warning: %s file %ith config option \"%s\" not found\n", CONFIG_FILENAME.c_str(), ocount, name.c_str());
-            continue;
+            if (filenames.empty()) { filenames.push_back(HISTORY_FILENAME); }
+            return history_stats::run(filenames, period);
+        }
+        if (cmd == "--mirror") {
+            /* simian --mirror [--jobs n] [--host url] [--dir path] */
+            std::size_t jobs = AssetFetcher::worker_count;
+            std::optional<std::string> host;
+            if (argc % 2 != 0) {
+                std::cerr << "fatal: main: --mirror option " << argv[argc - 1] << " needs a value\n";
+                return 1;
+            }
+            for (int i = 2; i + 1 < argc; i += 2) {
+                const std::string_view arg = argv[i];
+                const std::string value = argv[i + 1];
+                if (arg == "--jobs") {
+                    jobs = std::clamp<std::size_t>(std::strtoull(value.c_str(), nullptr, 10), 1, 64);
+                } else if (arg == "--host") {
+                    host = value;
+                } else if (arg == "--dir") {
+                    std::error_code ec;
+                    std::filesystem::create_directories(value, ec);
+                    std::filesystem::current_path(value, ec);
+                    if (ec) {
+                        std::cerr << "fatal: main: cannot use --dir " << value << ": " << ec.message() << '\n';
+                        return 1;
+                    }
+                } else {
+                    std::cerr << "fatal: main: unknown --mirror option " << arg << '\n';
+                    return 1;
+                }
+            }
+            /* read after --dir, so it is the mirror's own main.conf; it is optional, only the asset options are used and --host wins over asset_host */
+            std::vector<std::string> warnings;
+            read_config(warnings);
+            for (const std::string &warning : warnings) {
+                std::cerr << warning << '\n';
+            }
+            if (host.has_value()) {
+                if (!host->starts_with("http://") && !host->starts_with("https://")) {
+                    std::cerr << "fatal: main: --host " << host.value() << " must start with http:// or https://\n";
+                    return 1;
+                }
+                config["asset_host"] = host.value(); /* only for this run, main.conf is left alone */
+            }
+            load_settings();
+            if (settings().offline) {
+                std::cerr << "fatal: main: --mirror needs the network, but offline is set in " << CONFIG_FILENAME << '\n';
+                return 1;
+            }
+            return mirror::run(jobs);
         }
+        std::cerr << "fatal: main: unknown option " << cmd << '\n';
+        return 1;
+    }
 
-        config[name] = value;
+    std::setlocale(LC_ALL, "");
+
+    WINDOW* full_win = init_ncurses();
+    start_color();
+
+    std::vector<std::string> warnings;
+    if (!read_config(warnings)) {
+        deinit_ncurses();
+        std::cerr << "fatal: main: failed to open config file " << CONFIG_FILENAME << '\n';
+        return 1;
+    }
+    for (const std::string &warning : warnings) {
+        waddstr(full_win, (warning + '\n').c_str());
     }
+    const bool needs_confirmation = !warnings.empty();
 
     for (auto [name, value] : config) {
-        if (value.empty()) {
+        if (value.empty() && !optional_config.contains(name)) {
             deinit_ncurses();
             std::cerr << "fatal: main: " << CONFIG_FILENAME << " config " << name << " not set (\"" << name << "=...\")\n";
             return 1;
@@ -1275,18 +5090,42 @@ int main(int argc, char **argv) {
     refresh();
     if (needs_confirmation) { getch(); }
 
-    /* bool hc = str_rdb("hide_caret", "main"); */
-    /* bool fc = str_rdb("smooth_caret", "main"); */
+    load_settings();
 
-    Theme theme{};
-    get_theme(config["theme"], theme);
-
-    std::random_device device{};
-    std::default_random_engine engine{device()};
+    /* everything a first test may need starts downloading now, only the theme is waited for before the menu */
+    if (settings().theme != "custom") {
+        assets().prefetch("themes/" + settings().theme + ".css");
+    }
+    assets().prefetch("languages/" + settings().language + ".json");
+    assets().prefetch("quotes/" + settings().language.substr(0, settings().language.find('_')) + ".json");
 
-    std::vector<std::string> words, quotes;
-    get_words(words);
-    /* get_quotes(quotes, Quote::szshort); */
+    Theme theme{};
+    get_theme(settings().theme, theme);
+
+    /* an explicit seed gives the same word sequence every run, for benchmarking */
+    const std::uint64_t seed = settings().seed != 0 ? static_cast<std::uint64_t>(settings().seed) : (static_cast<std::uint64_t>(std::random_device{}()) << 32) ^ get_current_time_ns();
+
+    WordList words;
+    std::optional<WordGenerator> generator; /* made once a mode first needs words */
+    Xoshiro256 quote_engine(~seed);
+    QuoteStore quotes; /* compiled on first use */
+    CustomText custom_text; /* mapped on first use */
+    HistoryStore history(HISTORY_FILENAME, HISTORY_INDEX_FILENAME);
+    std::optional<Quote> quote_size;
+    std::optional<std::uint32_t> time_limit;
+    KeyStats keys;
+    keys.load(KEYSTATS_FILENAME);
+    BigramIndex bigrams;
+    const bool weakness = settings().word_source == "weakness";
+    auto word_source = [&]() -> WordGenerator & {
+        if (!generator.has_value()) {
+            get_words(words);
+            generator.emplace(words, settings().frequency_weighted, seed);
+            if (weakness) { get_bigram_index(words, bigrams); }
+        }
+        if (weakness) { generator->use_weakness(bigrams, keys); } /* picks up what the last test taught */
+        return generator.value();
+    };
 
     nccon(theme.sub_pair);
     move(0, 0);
@@ -1296,17 +5135,35 @@ int main(int argc, char **argv) {
     while (true) {
         switch (mode) {
             case Mode::words:
-                res = modes::words(full_win, words, engine, theme);
+                res = modes::words(full_win, word_source(), history, keys, theme);
                 break;
             case Mode::timed:
-                res = modes::timed(full_win, words, engine, theme);
+                res = modes::timed(full_win, word_source(), time_limit, history, keys, theme);
+                break;
+            case Mode::quote:
+                res = modes::quote(full_win, quotes, quote_size, quote_engine, history, keys, theme);
                 break;
             case Mode::zen:
-                res = modes::zen(full_win, theme);
+                res = modes::zen(full_win, history, theme);
                 break;
             case Mode::help:
                 res = modes::help(full_win, theme);
                 break;
+            case Mode::themes:
+                res = modes::themes(theme);
+                break;
+            case Mode::languages: {
+                const std::string before = settings().language;
+                res = modes::languages(theme);
+                if (settings().language != before) { /* the next test loads the new word list and quotes */
+                    generator.reset();
+                    quotes = QuoteStore{};
+                }
+                break;
+            }
+            case Mode::custom:
+                res = modes::custom(full_win, custom_text, history, keys, theme);
+                break;
             case Mode::end:
                 done = true;
                 break;
@@ -1320,6 +5177,8 @@ int main(int argc, char **argv) {
                 continue;
                 break;
             case State::switch_mode:
+                quote_size.reset();
+                time_limit.reset();
                 cleart(theme);
                 mode = ask_mode(full_win, theme);
                 break;